@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #include <SDL2/SDL.h>
 
 namespace pse {
@@ -25,4 +27,10 @@ constexpr SDL_Color Purple  = SDL_Color{ 128, 0, 255, 255 };
 constexpr SDL_Color Pink    = SDL_Color{ 255, 0, 255, 255 };
 constexpr SDL_Color Magenta = SDL_Color{ 255, 0, 127, 255 };
 
+// pack as SDL_PIXELFORMAT_ARGB8888
+constexpr uint32_t argb(SDL_Color c)
+{
+    return (uint32_t)c.a << 24 | (uint32_t)c.r << 16 | (uint32_t)c.g << 8 | (uint32_t)c.b;
+}
+
 } // pse
\ No newline at end of file
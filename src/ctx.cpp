@@ -9,11 +9,22 @@ namespace pse {
 
 #define US_PER_S 1000000.0
 
-Context::Context(const char* title, int w, int h, size_t fps)
+Context::Context(const char* title, int w, int h, size_t fps, unsigned int flags)
 {
-    SDL_Init(SDL_INIT_EVERYTHING);
-    
-    set_window(title, w, h, SDL_WINDOW_SHOWN);
+    context_flags = flags;
+
+    if (is_headless()) {
+        // no video subsystem, nothing here may need a display server
+        SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS);
+        set_surface();
+    }
+    else {
+        SDL_Init(SDL_INIT_EVERYTHING);
+        set_window(title, w, h, SDL_WINDOW_SHOWN);
+    }
+
+    if (is_software())
+        set_framebuffer(screen_width, screen_height);
 
     if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) != IMG_INIT_PNG) {
         fprintf(stderr, "Error: Failed to initialize SDL_image: %s\n", IMG_GetError());
@@ -49,9 +60,35 @@ void Context::set_window(const char *title, int w, int h, unsigned int flags)
     }
 }
 
+void Context::set_surface()
+{
+    if (surface) {
+        SDL_DestroyRenderer(renderer);
+        SDL_FreeSurface(surface);
+    }
+
+    surface = SDL_CreateRGBSurfaceWithFormat(0, screen_width, screen_height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        fprintf(stderr, "Error: Failed to initialize SDL Surface: %s\n", SDL_GetError());
+        exit(-1);
+    }
+
+    renderer = SDL_CreateSoftwareRenderer(surface);
+    if (!renderer) {
+        fprintf(stderr, "Error: Failed to initialize SDL Software Renderer: %s\n", SDL_GetError());
+        exit(-1);
+    }
+}
+
+bool Context::is_headless()
+{
+    return context_flags & PSE_CONTEXT_HEADLESS;
+}
+
 void Context::run(void (*setup)(Context& ctx), void (*update)(Context& ctx))
 {
-    srand(time(0));
+    // headless runs are seeded for repeatable measurements
+    srand(is_headless() ? 0 : time(0));
 
     auto time_now = []() {
         return std::chrono::high_resolution_clock::now();
@@ -64,12 +101,20 @@ void Context::run(void (*setup)(Context& ctx), void (*update)(Context& ctx))
     };
 
     double frame_time = 0.0;
-    auto frame_time_next = time_now();
-    auto frame_time_diff = time_now() - frame_time_next;
+    auto frame_start = time_now();
+    auto run_start = time_now();
 
     setup(*this);
 
     while (!done) {
+        auto phase_start = time_now();
+        auto phase_end = phase_start;
+        auto phase_record = [&](FramePhase phase) {
+            phase_end = time_now();
+            stats.record(phase, (double)time_in_us(phase_end - phase_start));
+            phase_start = phase_end;
+        };
+
         // keys
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
@@ -83,22 +128,50 @@ void Context::run(void (*setup)(Context& ctx), void (*update)(Context& ctx))
         SDL_GetMouseState(&mouse.x, &mouse.y);
         SDL_PumpEvents();
         keystate = (unsigned char*)SDL_GetKeyboardState(NULL);
+        phase_record(PHASE_EVENTS);
 
         // drawing
-        SDL_SetRenderDrawColor(renderer, pse::Black.r, pse::Black.g, pse::Black.b, pse::Black.a);
-        SDL_RenderClear(renderer);
+        draw_clear(pse::Black);
         update(*this);
+        phase_record(PHASE_UPDATE);
+
+        if (is_software())
+            soft_present();
+        else if (is_batched())
+            flush();
         SDL_RenderPresent(renderer);
+        phase_record(PHASE_PRESENT);
 
-        // frame management
-        frame_time_diff = time_now() - frame_time_next;
-        frame_time_next = time_now();
-        frame_time = time_in_us(frame_time_diff);
-        if (frame_time_target - frame_time > 0)
-            sleep_us(frame_time_target - frame_time);
+        // frame management, pace on the work done this frame only
+        double work_time = (double)time_in_us(phase_end - frame_start);
+        if (!is_headless() && frame_time_target - work_time > 0)
+            sleep_us(frame_time_target - work_time);
+        phase_record(PHASE_SLEEP);
+
+        // delta time covers the whole frame including the sleep
+        frame_time = (double)time_in_us(phase_end - frame_start);
+        stats.record(PHASE_FRAME, frame_time);
+        stats.next_frame();
+        frame_start = phase_end;
+
+        // headless runs as fast as possible but simulates at the frame target
+        if (is_headless())
+            frame_time = frame_time_target;
 
         frame_counter = (frame_counter + 1) % frame_target;
+        frame_total++;
         delta_time = frame_time / US_PER_S;
+
+        if (frame_limit && frame_total >= frame_limit)
+            done = true;
+    }
+
+    if (stats_path)
+        stats.dump_csv(stats_path);
+
+    if (is_headless()) {
+        double run_time = time_in_us(time_now() - run_start) / US_PER_S;
+        printf("%zu frames in %.3f s (%.1f fps)\n", frame_total, run_time, frame_total / run_time);
     }
 
     return;
@@ -108,9 +181,18 @@ Context::~Context()
 {
     for (auto t: textures)
         SDL_DestroyTexture(t);
+    for (auto s: surfaces)
+        SDL_FreeSurface(s);
+    if (framebuffer)
+        SDL_DestroyTexture(framebuffer);
+    if (upload)
+        SDL_DestroyTexture(upload);
     IMG_Quit();
     SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    if (window)
+        SDL_DestroyWindow(window);
+    if (surface)
+        SDL_FreeSurface(surface);
     SDL_Quit();
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <time.h>
 #include <vector>
 
@@ -7,6 +8,9 @@
 #include <SDL2/SDL_image.h>
 #undef main
 
+#include "frame_stats.hpp"
+#include "raster.hpp"
+
 namespace pse {
 
 // 4:3
@@ -21,14 +25,91 @@ namespace pse {
 #define PSE_RESOLUTION_169_1600_900 1600, 900
 #define PSE_RESOLUTION_169_1920_1080 1920, 1080
 
+// context flags
+#define PSE_CONTEXT_DEFAULT  0x00
+#define PSE_CONTEXT_HEADLESS 0x01 // render to an offscreen surface, no window
+#define PSE_CONTEXT_BATCHED  0x02 // record draw calls, submit them merged at present
+#define PSE_CONTEXT_SOFTWARE 0x04 // draw into a CPU pixel buffer, upload once per frame
+
+// largest atlas page, bigger images get a page of their own
+#define PSE_ATLAS_SIZE 2048
+
+// how many batches back a draw call may merge into, see ctx_batch.cpp
+#define PSE_BATCH_LOOKBACK 16
+
+// same layout as SDL_Vertex (SDL 2.0.18), which the bundled headers predate
+struct Vertex {
+    SDL_FPoint position;
+    SDL_Color color;
+    SDL_FPoint tex_coord; // normalized within the image, only used with a texture
+};
+
+// one draw_images record
+struct Sprite {
+    int id;         // from load_image
+    SDL_Rect rect;  // destination
+    SDL_Color tint = SDL_Color{ 255, 255, 255, 255 }; // multiplies the image
+};
+
 class Context {
 private:
     // SDL bindings
     SDL_Window* window = nullptr;
     SDL_Renderer* renderer = nullptr;
+    SDL_Surface* surface = nullptr; // offscreen target when headless
+    SDL_Texture* framebuffer = nullptr; // streaming upload of pixels when software
+    SDL_Texture* upload = nullptr; // streaming upload of draw_pixels buffers otherwise
     SDL_Event event = {0};
+    unsigned int context_flags = PSE_CONTEXT_DEFAULT;
+
+    // deferred draw commands, only used when batched
+    enum BatchType {
+        BATCH_POINTS,
+        BATCH_LINES, // segments as pairs of points
+        BATCH_RECTS,
+        BATCH_RECTS_FILL,
+        BATCH_IMAGES,
+        BATCH_GEOMETRY,
+    };
+    struct Batch {
+        BatchType type;
+        SDL_Color color;
+        int texture;
+        SDL_Rect bounds;
+        std::vector<SDL_Point> points;
+        std::vector<SDL_Rect> rects;
+        std::vector<SDL_Rect> srcs; // atlas source of each image rect
+        std::vector<Vertex> vertices;
+        std::vector<int> indices;
+    };
+    std::vector<Batch> batches{}; // pool, entries past batch_count are reused
+    size_t batch_count = 0;
+    bool batch_clear = false;
+    SDL_Color batch_clear_color = {0};
+    std::vector<SDL_Point> batch_polyline{};
+
+    // per radius circle tables, built on first use, see ctx_draw.cpp
+    struct CircleTable {
+        std::vector<int> half_widths; // for |dy| in [0, radius]
+        std::vector<SDL_Point> outline; // offsets from the center
+    };
+    std::vector<CircleTable> circles{};
+    std::vector<SDL_Point> scratch_points{};
+    std::vector<SDL_Rect> scratch_rects{};
+    std::vector<Vertex> scratch_vertices{};
+    std::vector<int> scratch_indices{};
+
+    // every loaded image lives in an atlas page, see ctx_atlas.cpp
+    struct Image {
+        int page;     // index into textures
+        SDL_Rect src; // location within the page
+    };
+    std::vector<Image> images{};
+    bool atlas_dirty = false;
 public:
-    std::vector<SDL_Texture *> textures{};
+    std::vector<SDL_Texture *> textures{}; // atlas pages
+    std::vector<SDL_Surface *> surfaces{}; // ARGB8888 loaded images by ID
+    std::vector<uint32_t> pixels{}; // ARGB8888 screen_width * screen_height when software
 
     // input devices
     struct {
@@ -45,7 +126,11 @@ private:
 public:
     size_t frame_target = 60;
     size_t frame_counter = 0;
+    size_t frame_total = 0; // frames run since start
+    size_t frame_limit = 0; // stop after this many frames, 0 for no limit
     double delta_time = 1.0;
+    FrameStats stats{}; // per phase timings of recent frames
+    const char* stats_path = nullptr; // write stats as CSV here when run returns
 
     // window data
     int screen_width = 640;
@@ -53,16 +138,22 @@ public:
     const char* title = nullptr;
     bool done = false;
 
-    Context(const char *title, int w, int h, size_t fps);
+    Context(const char *title, int w, int h, size_t fps, unsigned int flags = PSE_CONTEXT_DEFAULT);
     ~Context();
     void set_window(const char *title, int w, int h, unsigned int flags);
+    void set_surface(); // render offscreen into a surface of screen_width x screen_height, as set_window sizes its window
+    bool is_headless();
+    bool is_batched();
+    bool is_software();
+    bool has_geometry(); // runtime SDL provides SDL_RenderGeometry
     void run(void (*setup)(Context& ctx), void (*update)(Context& ctx));
     bool check_key(int sdl_scancode);
     bool check_key_invalidate(int sdl_scancode);
     void quit();
 
-    int load_image(const char *path); // put an image into textures, return its ID
+    int load_image(const char *path); // put an image into the atlas, return its ID
     void draw_image(int id, SDL_Rect rect); // draw an image to coordinates
+    void draw_images(const Sprite *sprites, int count); // draw in order, as one geometry call per atlas page run
     void draw_clear(SDL_Color c); // clear entire surface
     void draw_rect(SDL_Color c, SDL_Rect rect); // draw rectangle outline
     void draw_rect_fill(SDL_Color c, SDL_Rect rect); // draw filled rectangle
@@ -71,8 +162,43 @@ public:
     void draw_line(SDL_Color c, int x1, int y1, int x2, int y2); // draw a line
     void draw_tri(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3);
     void draw_tri_fill(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3);
+    void draw_tri_fillf(SDL_Color c, float x1, float y1, float x2, float y2, float x3, float y3); // subpixel vertices
+    void draw_tris_fill(const SDL_FPoint *points, const SDL_Color *colors, int count); // count triangles, 3 points each
+    // triangle list, indexed when indices is set, id of -1 draws untextured
+    void draw_geometry(int id, const Vertex *vertices, int vertex_count, const int *indices = nullptr, int index_count = 0);
+    void draw_pixels(const uint32_t *argb, int w, int h); // opaque ARGB8888 buffer scaled over the whole screen
+    void flush(); // submit recorded draw calls, done before every present
 private:
     void set_frame_target(size_t target);
+    CircleTable& circle_table(int radius);
+    void atlas_build(); // pack all loaded images into textures
+    void fill_tri_fixed(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3); // 28.4 vertices
+    void scan_tri_fixed(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3);
+    void raster_tri(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3); // software only, see raster_blocks
+
+    // backend primitives every draw_* goes through, see ctx_batch.cpp
+    void emit_clear(SDL_Color c);
+    void emit_points(SDL_Color c, const SDL_Point *points, int count);
+    void emit_lines(SDL_Color c, const SDL_Point *segments, int count); // count segments
+    void emit_rects(SDL_Color c, const SDL_Rect *rects, int count, bool fill);
+    void emit_image(int id, SDL_Rect rect, SDL_Color tint);
+    void emit_geometry(int page, const Vertex *vertices, int vertex_count, const int *indices, int index_count); // page UVs
+    void emit_pixels(const uint32_t *argb, int w, int h);
+    void geometry_fallback(const Vertex *vertices, int vertex_count, const int *indices, int index_count);
+    void flush_geometry(Batch& b);
+    void flush_images(Batch& b); // one quad list per page and tint where SDL_RenderGeometry is there
+    Batch& batch_get(BatchType type, SDL_Color c, int texture, SDL_Rect bounds);
+
+    // software backend, see ctx_software.cpp
+    void set_framebuffer(int w, int h);
+    void soft_span(uint32_t color, int x1, int x2, int y); // inclusive, clipped
+    void soft_clear(SDL_Color c);
+    void soft_points(SDL_Color c, const SDL_Point *points, int count);
+    void soft_lines(SDL_Color c, const SDL_Point *segments, int count);
+    void soft_rects(SDL_Color c, const SDL_Rect *rects, int count, bool fill);
+    void soft_image(int id, SDL_Rect rect, SDL_Color tint);
+    void soft_pixels(const uint32_t *argb, int w, int h);
+    void soft_present();
 };
 
 } // pse
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+
+#include "ctx.hpp"
+
+namespace pse {
+
+/**
+ * Images from load_image are packed onto as few atlas pages as possible with
+ * shelf packing, tallest first, so drawing any number of them from the same
+ * page never switches textures. IDs stay the index into images; only the page
+ * and source rect behind them change when the atlas is rebuilt.
+ */
+
+#define ATLAS_PADDING 1 // keeps filtered sampling from bleeding into neighbors
+
+void Context::atlas_build()
+{
+    atlas_dirty = false;
+
+    // recorded batches point into the old pages
+    if (batch_count)
+        flush();
+
+    for (auto t : textures)
+        SDL_DestroyTexture(t);
+    textures.clear();
+
+    int page_size = PSE_ATLAS_SIZE;
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0 && info.max_texture_width > 0)
+        page_size = std::min(page_size, (int)std::min(info.max_texture_width, info.max_texture_height));
+
+    std::vector<int> order(images.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return images[a].src.h > images[b].src.h;
+    });
+
+    // shelves fill left to right, a new shelf starts under the tallest of the last
+    struct Page {
+        bool single; // one oversized image, nothing else fits
+        int shelf_x, shelf_y, shelf_h;
+        std::vector<int> ids;
+    };
+    std::vector<Page> pages;
+
+    for (int id : order) {
+        Image& image = images[id];
+        int w = image.src.w + ATLAS_PADDING;
+        int h = image.src.h + ATLAS_PADDING;
+
+        bool single = w > page_size || h > page_size;
+        bool placed = false;
+        for (size_t i = 0; i < pages.size() && !single && !placed; i++) {
+            Page& p = pages[i];
+            if (p.single) continue;
+
+            int x = p.shelf_x, y = p.shelf_y, shelf_h = p.shelf_h;
+            if (x + w > page_size) {
+                x = 0;
+                y += shelf_h;
+                shelf_h = 0;
+            }
+            if (y + h > page_size) continue;
+
+            image.page = (int)i;
+            image.src.x = x;
+            image.src.y = y;
+            p.shelf_x = x + w;
+            p.shelf_y = y;
+            p.shelf_h = std::max(shelf_h, h);
+            p.ids.push_back(id);
+            placed = true;
+        }
+        if (!placed) {
+            image.page = (int)pages.size();
+            image.src.x = 0;
+            image.src.y = 0;
+            pages.push_back(Page{ single, w, 0, h, { id } });
+        }
+    }
+
+    for (Page& p : pages) {
+        // pages only as tall as their shelves need
+        int used_w = 0, used_h = 0;
+        for (int id : p.ids) {
+            used_w = std::max(used_w, images[id].src.x + images[id].src.w);
+            used_h = std::max(used_h, images[id].src.y + images[id].src.h);
+        }
+
+        SDL_Surface *page = SDL_CreateRGBSurfaceWithFormat(0, used_w, used_h, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (!page) {
+            fprintf(stderr, "Error: Failed to create atlas page: %s\n", SDL_GetError());
+            exit(-1);
+        }
+        for (int id : p.ids) {
+            SDL_Rect dst = images[id].src;
+            SDL_SetSurfaceBlendMode(surfaces[id], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(surfaces[id], NULL, page, &dst);
+        }
+
+        SDL_Texture *t = SDL_CreateTextureFromSurface(renderer, page);
+        SDL_FreeSurface(page);
+        if (!t) {
+            fprintf(stderr, "Error: Failed to create atlas texture: %s\n", SDL_GetError());
+            exit(-1);
+        }
+        SDL_SetTextureBlendMode(t, SDL_BLENDMODE_BLEND);
+        textures.push_back(t);
+    }
+}
+
+} // pse
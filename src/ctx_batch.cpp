@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ctx.hpp"
+
+namespace pse {
+
+/**
+ * Every draw_* call ends up in one of the emit_* primitives. Immediate mode
+ * hands them straight to SDL and the software backend writes them into
+ * pixels. Batched mode records them instead: a call joins the newest batch
+ * with the same state (type, color, texture) as long as no batch recorded
+ * after that one overlaps it, so painter's order is kept while non-overlapping
+ * draws such as tile maps collapse into a few batches. flush() then submits
+ * each batch with a single state change and batched SDL call.
+ */
+
+static bool colors_equal(SDL_Color c1, SDL_Color c2)
+{
+    return c1.r == c2.r && c1.g == c2.g && c1.b == c2.b && c1.a == c2.a;
+}
+
+static SDL_Rect points_bounds(const SDL_Point *points, int count)
+{
+    int x1 = points[0].x, x2 = points[0].x;
+    int y1 = points[0].y, y2 = points[0].y;
+    for (int i = 1; i < count; i++) {
+        x1 = std::min(x1, points[i].x);
+        x2 = std::max(x2, points[i].x);
+        y1 = std::min(y1, points[i].y);
+        y2 = std::max(y2, points[i].y);
+    }
+    return SDL_Rect{ x1, y1, x2 - x1 + 1, y2 - y1 + 1 };
+}
+
+static SDL_Rect rects_bounds(const SDL_Rect *rects, int count)
+{
+    SDL_Rect bounds = rects[0];
+    for (int i = 1; i < count; i++)
+        SDL_UnionRect(&bounds, &rects[i], &bounds);
+    return bounds;
+}
+
+bool Context::is_batched()
+{
+    return context_flags & PSE_CONTEXT_BATCHED;
+}
+
+Context::Batch& Context::batch_get(BatchType type, SDL_Color c, int texture, SDL_Rect bounds)
+{
+    // merge into an earlier batch unless something drawn since overlaps
+    size_t stop = batch_count > PSE_BATCH_LOOKBACK ? batch_count - PSE_BATCH_LOOKBACK : 0;
+    for (size_t i = batch_count; i > stop; i--) {
+        Batch& b = batches[i - 1];
+        if (b.type == type && b.texture == texture && colors_equal(b.color, c)) {
+            SDL_UnionRect(&b.bounds, &bounds, &b.bounds);
+            return b;
+        }
+        if (SDL_HasIntersection(&b.bounds, &bounds))
+            break;
+    }
+
+    if (batch_count == batches.size())
+        batches.emplace_back();
+
+    Batch& b = batches[batch_count++];
+    b.type = type;
+    b.color = c;
+    b.texture = texture;
+    b.bounds = bounds;
+    b.points.clear();
+    b.rects.clear();
+    b.srcs.clear();
+    b.vertices.clear();
+    b.indices.clear();
+    return b;
+}
+
+void Context::emit_clear(SDL_Color c)
+{
+    if (is_software()) {
+        soft_clear(c);
+        return;
+    }
+    if (is_batched()) {
+        // everything recorded so far would be cleared anyway
+        batch_count = 0;
+        batch_clear = true;
+        batch_clear_color = c;
+        return;
+    }
+
+    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+    SDL_RenderClear(renderer);
+}
+
+void Context::emit_points(SDL_Color c, const SDL_Point *points, int count)
+{
+    if (count <= 0) return;
+
+    if (is_software()) {
+        soft_points(c, points, count);
+        return;
+    }
+    if (is_batched()) {
+        Batch& b = batch_get(BATCH_POINTS, c, -1, points_bounds(points, count));
+        b.points.insert(b.points.end(), points, points + count);
+        return;
+    }
+
+    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+    SDL_RenderDrawPoints(renderer, points, count);
+}
+
+void Context::emit_lines(SDL_Color c, const SDL_Point *segments, int count)
+{
+    if (count <= 0) return;
+
+    if (is_software()) {
+        soft_lines(c, segments, count);
+        return;
+    }
+    if (is_batched()) {
+        Batch& b = batch_get(BATCH_LINES, c, -1, points_bounds(segments, count * 2));
+        b.points.insert(b.points.end(), segments, segments + count * 2);
+        return;
+    }
+
+    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+    for (int i = 0; i < count; i++)
+        SDL_RenderDrawLine(renderer, segments[i * 2].x, segments[i * 2].y, segments[i * 2 + 1].x, segments[i * 2 + 1].y);
+}
+
+void Context::emit_rects(SDL_Color c, const SDL_Rect *rects, int count, bool fill)
+{
+    if (count <= 0) return;
+
+    if (is_software()) {
+        soft_rects(c, rects, count, fill);
+        return;
+    }
+    if (is_batched()) {
+        Batch& b = batch_get(fill ? BATCH_RECTS_FILL : BATCH_RECTS, c, -1, rects_bounds(rects, count));
+        b.rects.insert(b.rects.end(), rects, rects + count);
+        return;
+    }
+
+    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+    if (fill)
+        SDL_RenderFillRects(renderer, rects, count);
+    else
+        SDL_RenderDrawRects(renderer, rects, count);
+}
+
+void Context::emit_image(int id, SDL_Rect rect, SDL_Color tint)
+{
+    if (is_software()) {
+        soft_image(id, rect, tint);
+        return;
+    }
+
+    if (atlas_dirty)
+        atlas_build();
+    Image& image = images[id];
+
+    if (is_batched()) {
+        // keyed by page and tint so every image on it shares a batch
+        Batch& b = batch_get(BATCH_IMAGES, tint, image.page, rect);
+        b.rects.push_back(rect);
+        b.srcs.push_back(image.src);
+        return;
+    }
+
+    SDL_Texture *page = textures[image.page];
+    SDL_SetTextureColorMod(page, tint.r, tint.g, tint.b);
+    SDL_SetTextureAlphaMod(page, tint.a);
+    SDL_RenderCopy(renderer, page, &image.src, &rect);
+}
+
+void Context::emit_pixels(const uint32_t *argb, int w, int h)
+{
+    if (is_software()) {
+        soft_pixels(argb, w, h);
+        return;
+    }
+    if (is_batched()) {
+        // the buffer is only valid now, so submit what came before and upload it directly
+        flush();
+    }
+
+    if (upload) {
+        int upload_w, upload_h;
+        SDL_QueryTexture(upload, NULL, NULL, &upload_w, &upload_h);
+        if (upload_w != w || upload_h != h) {
+            SDL_DestroyTexture(upload);
+            upload = nullptr;
+        }
+    }
+    if (!upload) {
+        upload = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+        if (!upload) {
+            fprintf(stderr, "Error: Failed to initialize upload texture: %s\n", SDL_GetError());
+            exit(-1);
+        }
+    }
+    SDL_UpdateTexture(upload, NULL, argb, w * (int)sizeof(uint32_t));
+    SDL_RenderCopy(renderer, upload, NULL, NULL);
+}
+
+void Context::flush()
+{
+    if (batch_clear) {
+        SDL_SetRenderDrawColor(renderer, batch_clear_color.r, batch_clear_color.g, batch_clear_color.b, batch_clear_color.a);
+        SDL_RenderClear(renderer);
+        batch_clear = false;
+    }
+
+    for (size_t i = 0; i < batch_count; i++) {
+        Batch& b = batches[i];
+        if (b.type != BATCH_IMAGES && b.type != BATCH_GEOMETRY)
+            SDL_SetRenderDrawColor(renderer, b.color.r, b.color.g, b.color.b, b.color.a);
+
+        switch (b.type) {
+        case BATCH_POINTS:
+            SDL_RenderDrawPoints(renderer, b.points.data(), (int)b.points.size());
+            break;
+        case BATCH_LINES: {
+            // join segments sharing end points into polylines
+            batch_polyline.clear();
+            for (size_t j = 0; j < b.points.size(); j += 2) {
+                SDL_Point& p1 = b.points[j];
+                SDL_Point& p2 = b.points[j + 1];
+                if (!batch_polyline.empty()
+                    && (batch_polyline.back().x != p1.x || batch_polyline.back().y != p1.y)) {
+                    SDL_RenderDrawLines(renderer, batch_polyline.data(), (int)batch_polyline.size());
+                    batch_polyline.clear();
+                }
+                if (batch_polyline.empty())
+                    batch_polyline.push_back(p1);
+                batch_polyline.push_back(p2);
+            }
+            SDL_RenderDrawLines(renderer, batch_polyline.data(), (int)batch_polyline.size());
+            break;
+        }
+        case BATCH_RECTS:
+            SDL_RenderDrawRects(renderer, b.rects.data(), (int)b.rects.size());
+            break;
+        case BATCH_RECTS_FILL:
+            SDL_RenderFillRects(renderer, b.rects.data(), (int)b.rects.size());
+            break;
+        case BATCH_IMAGES:
+            flush_images(b);
+            break;
+        case BATCH_GEOMETRY:
+            flush_geometry(b);
+            break;
+        }
+    }
+    batch_count = 0;
+}
+
+} // pse
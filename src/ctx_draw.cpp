@@ -1,6 +1,8 @@
 #include <algorithm>
+#include <cmath>
 #include <stdio.h>
 
+#include "colors.hpp"
 #include "ctx.hpp"
 #include "util.hpp"
 
@@ -8,41 +10,60 @@ namespace pse {
 
 int Context::load_image(const char *path)
 {
-    SDL_Texture *t = IMG_LoadTexture(renderer, path);
-    if (!t) {
+    SDL_Surface *s = IMG_Load(path);
+    if (!s) {
         fprintf(stderr, "Error: Invalid texture/path: '%s'\n", path);
         exit(-1);
     }
-    textures.push_back(t);
-    return (int)textures.size() - 1;
+
+    // one format for atlas packing and software blits
+    SDL_Surface *converted = SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(s);
+    if (!converted) {
+        fprintf(stderr, "Error: Failed to convert texture: '%s'\n", path);
+        exit(-1);
+    }
+
+    surfaces.push_back(converted);
+    images.push_back(Image{ -1, SDL_Rect{ 0, 0, converted->w, converted->h } });
+    atlas_dirty = true;
+    return (int)images.size() - 1;
 }
 
 void Context::draw_image(int id, SDL_Rect rect)
 {
-    SDL_RenderCopy(renderer, textures[id], NULL, &rect);
+    emit_image(id, rect, White);
 }
 
 void Context::draw_clear(SDL_Color c)
 {
-    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
-    SDL_RenderClear(renderer);
+    emit_clear(c);
+}
+
+void Context::draw_pixels(const uint32_t *argb, int w, int h)
+{
+    if (w <= 0 || h <= 0) return;
+    emit_pixels(argb, w, h);
 }
 
 void Context::draw_rect(SDL_Color c, SDL_Rect rect)
 {
-    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
-    SDL_RenderDrawRect(renderer, &rect);
+    emit_rects(c, &rect, 1, false);
 }
 
 void Context::draw_rect_fill(SDL_Color c, SDL_Rect rect)
 {
-    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
-    SDL_RenderFillRect(renderer, &rect);
+    emit_rects(c, &rect, 1, true);
 }
 
-void Context::draw_circle(SDL_Color c, int x, int y, int radius)
+Context::CircleTable& Context::circle_table(int radius)
 {
-    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+    if ((size_t)radius >= circles.size())
+        circles.resize(radius + 1);
+
+    CircleTable& table = circles[radius];
+    if (!table.half_widths.empty())
+        return table;
 
     // https://stackoverflow.com/questions/38334081/howto-draw-circles-arcs-and-vector-graphics-in-sdl
 
@@ -57,14 +78,14 @@ void Context::draw_circle(SDL_Color c, int x, int y, int radius)
     while (cx >= cy)
     {
         //  Each of the following renders an octant of the circle
-        SDL_RenderDrawPoint(renderer, x + cx, y - cy);
-        SDL_RenderDrawPoint(renderer, x + cx, y + cy);
-        SDL_RenderDrawPoint(renderer, x - cx, y - cy);
-        SDL_RenderDrawPoint(renderer, x - cx, y + cy);
-        SDL_RenderDrawPoint(renderer, x + cy, y - cx);
-        SDL_RenderDrawPoint(renderer, x + cy, y + cx);
-        SDL_RenderDrawPoint(renderer, x - cy, y - cx);
-        SDL_RenderDrawPoint(renderer, x - cy, y + cx);
+        table.outline.push_back({ +cx, -cy });
+        table.outline.push_back({ +cx, +cy });
+        table.outline.push_back({ -cx, -cy });
+        table.outline.push_back({ -cx, +cy });
+        table.outline.push_back({ +cy, -cx });
+        table.outline.push_back({ +cy, +cx });
+        table.outline.push_back({ -cy, -cx });
+        table.outline.push_back({ -cy, +cx });
 
         if (error <= 0) {
             ++cy;
@@ -78,82 +99,121 @@ void Context::draw_circle(SDL_Color c, int x, int y, int radius)
             error += (tx - diameter);
         }
     }
-}
 
-void Context::draw_circle_fill(SDL_Color c, int x, int y, int radius)
-{
-    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+    // widest dx where dx * dx + dy * dy <= radius * radius, for each |dy|
+    table.half_widths.resize(radius + 1);
+    int dx = radius;
+    for (int dy = 0; dy <= radius; dy++) {
+        while (dx * dx + dy * dy > radius * radius)
+            dx--;
+        table.half_widths[dy] = dx;
+    }
 
-    // https://stackoverflow.com/questions/28346989/drawing-and-filling-a-circle
+    return table;
+}
 
-    int w, h, dx, dy;
+void Context::draw_circle(SDL_Color c, int x, int y, int radius)
+{
+    if (radius <= 0) return;
 
-    for (w = 0; w < radius * 2; w++) {
-        for (h = 0; h < radius * 2; h++) {
+    CircleTable& table = circle_table(radius);
+    scratch_points.resize(table.outline.size());
+    for (size_t i = 0; i < table.outline.size(); i++)
+        scratch_points[i] = SDL_Point{ x + table.outline[i].x, y + table.outline[i].y };
+    emit_points(c, scratch_points.data(), (int)scratch_points.size());
+}
 
-            dx = radius - w; // horizontal offset
-            dy = radius - h; // vertical offset
+void Context::draw_circle_fill(SDL_Color c, int x, int y, int radius)
+{
+    if (radius <= 0) return;
 
-            if ((dx * dx + dy * dy) <= (radius * radius)) {
-                SDL_RenderDrawPoint(renderer, x + dx, y + dy);
-            }
-        }
+    // https://stackoverflow.com/questions/28346989/drawing-and-filling-a-circle
+    // offsets run over (-radius, radius], one horizontal span per row
+
+    CircleTable& table = circle_table(radius);
+    scratch_rects.clear();
+    for (int dy = -radius + 1; dy <= radius; dy++) {
+        int half = table.half_widths[std::abs(dy)];
+        int left = std::max(-half, -radius + 1);
+        scratch_rects.push_back(SDL_Rect{ x + left, y + dy, half - left + 1, 1 });
     }
+    emit_rects(c, scratch_rects.data(), (int)scratch_rects.size(), true);
 }
 
 void Context::draw_line(SDL_Color c, int x1, int y1, int x2, int y2)
 {
-    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
-
-    SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
+    SDL_Point segment[2] = { { x1, y1 }, { x2, y2 } };
+    emit_lines(c, segment, 1);
 }
 
 void Context::draw_tri(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3)
 {
     if (x1 == x2 && x1 == x3) return;
-    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
-    SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
-    SDL_RenderDrawLine(renderer, x2, y2, x3, y3);
-    SDL_RenderDrawLine(renderer, x3, y3, x1, y1);
+    SDL_Point segments[6] = {
+        { x1, y1 }, { x2, y2 },
+        { x2, y2 }, { x3, y3 },
+        { x3, y3 }, { x1, y1 },
+    };
+    emit_lines(c, segments, 3);
 }
 
 void Context::draw_tri_fill(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3)
 {
-    SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
-
-    // https://www.youtube.com/watch?v=PahbNFypubE ~10:30
+    fill_tri_fixed(c,
+        x1 * PSE_SUBPIXEL_ONE, y1 * PSE_SUBPIXEL_ONE,
+        x2 * PSE_SUBPIXEL_ONE, y2 * PSE_SUBPIXEL_ONE,
+        x3 * PSE_SUBPIXEL_ONE, y3 * PSE_SUBPIXEL_ONE);
+}
 
-    // find the top point
-    int y, t;
+void Context::draw_tri_fillf(SDL_Color c, float x1, float y1, float x2, float y2, float x3, float y3)
+{
+    auto fixed = [](float v) {
+        return (int)lroundf(v * PSE_SUBPIXEL_ONE);
+    };
+    fill_tri_fixed(c, fixed(x1), fixed(y1), fixed(x2), fixed(y2), fixed(x3), fixed(y3));
+}
 
-    // sort points
-    if (y2 < y1) {
-        t = x1; x1 = x2; x2 = t;
-        t = y1; y1 = y2; y2 = t;
-    }
-    if (y3 < y1) {
-        t = x1; x1 = x3; x3 = t;
-        t = y1; y1 = y3; y3 = t;
-    }
-    if (y3 < y2) {
-        t = x2; x2 = x3; x3 = t;
-        t = y2; y2 = y3; y3 = t;
+void Context::draw_tris_fill(const SDL_FPoint *points, const SDL_Color *colors, int count)
+{
+    auto fixed = [](float v) {
+        return (int)lroundf(v * PSE_SUBPIXEL_ONE);
+    };
+    for (int i = 0; i < count; i++) {
+        const SDL_FPoint *p = &points[i * 3];
+        fill_tri_fixed(colors[i],
+            fixed(p[0].x), fixed(p[0].y),
+            fixed(p[1].x), fixed(p[1].y),
+            fixed(p[2].x), fixed(p[2].y));
     }
+}
 
-    // triangle has no area
-    if (y1 == y3) return;
+void Context::fill_tri_fixed(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3)
+{
+    if (is_software())
+        raster_tri(c, x1, y1, x2, y2, x3, y3);
+    else
+        scan_tri_fixed(c, x1, y1, x2, y2, x3, y3);
+}
 
-    if (y1 < y2) {
-        //slopes[shortside] = (y2 - y1) / (x1 - x2);
-        for (y = y1; y < y2; y++) {
-            SDL_RenderDrawLine(renderer, x1 + (x2 - x1) * (y - y1) / (y2 - y1), y, x1 + (x3 - x1) * (y - y1) / (y3 - y1), y);
-        }
-    }
-    if (y2 < y3) {
-        for (y = y2; y < y3; y++) {
-            SDL_RenderDrawLine(renderer, x2 + (x3 - x2) * (y - y2) / (y3 - y2), y, x1 + (x3 - x1) * (y - y1) / (y3 - y1), y);
-        }
-    }
+/**
+ * Scanline fill of a triangle with vertices in 28.4 fixed point, see
+ * raster_spans. Every span goes out in a single emit_rects.
+ */
+void Context::scan_tri_fixed(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3)
+{
+    scratch_rects.clear();
+    raster_spans(x1, y1, x2, y2, x3, y3, screen_width, screen_height, scratch_rects);
+    emit_rects(c, scratch_rects.data(), (int)scratch_rects.size(), true);
+}
+
+/**
+ * Block fill straight into the software framebuffer, see raster_blocks.
+ * Triangles too large for it go through the scanline path instead.
+ */
+void Context::raster_tri(SDL_Color c, int x1, int y1, int x2, int y2, int x3, int y3)
+{
+    if (!raster_blocks(x1, y1, x2, y2, x3, y3, screen_width, screen_height, argb(c), pixels.data()))
+        scan_tri_fixed(c, x1, y1, x2, y2, x3, y3);
 }
 
 } // pse
@@ -0,0 +1,208 @@
+#include <cmath>
+
+#include "ctx.hpp"
+
+namespace pse {
+
+/**
+ * SDL_RenderGeometry only exists from SDL 2.0.18, newer than the bundled
+ * headers and DLLs, so it is looked up in the loaded SDL at runtime. Without
+ * it triangles go through the scanline rasterizer one flat color at a time,
+ * and draw_images and batched images fall back to drawing their sprites one
+ * by one.
+ */
+
+static_assert(sizeof(Vertex) == 20, "pse::Vertex must match SDL_Vertex");
+
+typedef int (SDLCALL *RenderGeometryFn)(SDL_Renderer *renderer, SDL_Texture *texture,
+    const Vertex *vertices, int num_vertices, const int *indices, int num_indices);
+
+static RenderGeometryFn render_geometry()
+{
+    static RenderGeometryFn fn = []() {
+#ifdef _WIN32
+        void *sdl = SDL_LoadObject("SDL2.dll");
+#else
+        void *sdl = SDL_LoadObject(NULL); // symbols already loaded into the process
+#endif
+        if (!sdl)
+            return (RenderGeometryFn)nullptr;
+        return (RenderGeometryFn)SDL_LoadFunction(sdl, "SDL_RenderGeometry");
+    }();
+    return fn;
+}
+
+// an indexed quad over dst showing src of a page_w x page_h page, tinted by c
+static void push_quad(std::vector<Vertex>& vertices, std::vector<int>& indices,
+    const SDL_Rect& dst, const SDL_Rect& src, int page_w, int page_h, SDL_Color c)
+{
+    float x1 = (float)dst.x, x2 = (float)(dst.x + dst.w);
+    float y1 = (float)dst.y, y2 = (float)(dst.y + dst.h);
+    float u1 = (float)src.x / page_w, u2 = (float)(src.x + src.w) / page_w;
+    float v1 = (float)src.y / page_h, v2 = (float)(src.y + src.h) / page_h;
+
+    int base = (int)vertices.size();
+    vertices.push_back(Vertex{ { x1, y1 }, c, { u1, v1 } });
+    vertices.push_back(Vertex{ { x2, y1 }, c, { u2, v1 } });
+    vertices.push_back(Vertex{ { x2, y2 }, c, { u2, v2 } });
+    vertices.push_back(Vertex{ { x1, y2 }, c, { u1, v2 } });
+    for (int k : { 0, 1, 2, 0, 2, 3 })
+        indices.push_back(base + k);
+}
+
+bool Context::has_geometry()
+{
+    return render_geometry() != nullptr;
+}
+
+void Context::draw_geometry(int id, const Vertex *vertices, int vertex_count, const int *indices, int index_count)
+{
+    if (id < 0 || vertex_count <= 0 || is_software() || !has_geometry()) {
+        emit_geometry(-1, vertices, vertex_count, indices, index_count);
+        return;
+    }
+
+    // texture coordinates are relative to the image, move them into its atlas page
+    if (atlas_dirty)
+        atlas_build();
+    Image& image = images[id];
+    int page_w, page_h;
+    SDL_QueryTexture(textures[image.page], NULL, NULL, &page_w, &page_h);
+
+    scratch_vertices.assign(vertices, vertices + vertex_count);
+    for (Vertex& v : scratch_vertices) {
+        v.tex_coord.x = (image.src.x + v.tex_coord.x * image.src.w) / page_w;
+        v.tex_coord.y = (image.src.y + v.tex_coord.y * image.src.h) / page_h;
+    }
+    emit_geometry(image.page, scratch_vertices.data(), vertex_count, indices, index_count);
+}
+
+void Context::draw_images(const Sprite *sprites, int count)
+{
+    if (count <= 0) return;
+
+    if (is_software() || !has_geometry()) {
+        for (int i = 0; i < count; i++)
+            emit_image(sprites[i].id, sprites[i].rect, sprites[i].tint);
+        return;
+    }
+
+    if (atlas_dirty)
+        atlas_build();
+
+    // each run of sprites sharing a page becomes one indexed quad list
+    for (int start = 0; start < count; ) {
+        int page = images[sprites[start].id].page;
+        int end = start + 1;
+        while (end < count && images[sprites[end].id].page == page)
+            end++;
+
+        int page_w, page_h;
+        SDL_QueryTexture(textures[page], NULL, NULL, &page_w, &page_h);
+
+        scratch_vertices.clear();
+        scratch_indices.clear();
+        for (int i = start; i < end; i++)
+            push_quad(scratch_vertices, scratch_indices, sprites[i].rect, images[sprites[i].id].src, page_w, page_h, sprites[i].tint);
+        emit_geometry(page, scratch_vertices.data(), (int)scratch_vertices.size(),
+            scratch_indices.data(), (int)scratch_indices.size());
+        start = end;
+    }
+}
+
+void Context::emit_geometry(int page, const Vertex *vertices, int vertex_count, const int *indices, int index_count)
+{
+    if (vertex_count <= 0) return;
+
+    if (is_software() || !has_geometry()) {
+        geometry_fallback(vertices, vertex_count, indices, index_count);
+        return;
+    }
+
+    if (is_batched()) {
+        float x1 = vertices[0].position.x, x2 = x1;
+        float y1 = vertices[0].position.y, y2 = y1;
+        for (int i = 1; i < vertex_count; i++) {
+            x1 = fminf(x1, vertices[i].position.x);
+            x2 = fmaxf(x2, vertices[i].position.x);
+            y1 = fminf(y1, vertices[i].position.y);
+            y2 = fmaxf(y2, vertices[i].position.y);
+        }
+        SDL_Rect bounds = { (int)floorf(x1), (int)floorf(y1), (int)ceilf(x2 - x1) + 1, (int)ceilf(y2 - y1) + 1 };
+
+        // batches are always indexed so appended lists keep their own vertices
+        Batch& b = batch_get(BATCH_GEOMETRY, SDL_Color{0}, page, bounds);
+        int base = (int)b.vertices.size();
+        b.vertices.insert(b.vertices.end(), vertices, vertices + vertex_count);
+        if (indices) {
+            for (int i = 0; i < index_count; i++)
+                b.indices.push_back(base + indices[i]);
+        }
+        else {
+            for (int i = 0; i < vertex_count; i++)
+                b.indices.push_back(base + i);
+        }
+        return;
+    }
+
+    render_geometry()(renderer, page >= 0 ? textures[page] : NULL, vertices, vertex_count, indices, index_count);
+}
+
+void Context::geometry_fallback(const Vertex *vertices, int vertex_count, const int *indices, int index_count)
+{
+    auto fixed = [](float v) {
+        return (int)lroundf(v * PSE_SUBPIXEL_ONE);
+    };
+
+    // flat shaded with the average of the vertex colors, texture ignored
+    int count = indices ? index_count : vertex_count;
+    for (int i = 0; i + 2 < count; i += 3) {
+        const Vertex& v1 = vertices[indices ? indices[i] : i];
+        const Vertex& v2 = vertices[indices ? indices[i + 1] : i + 1];
+        const Vertex& v3 = vertices[indices ? indices[i + 2] : i + 2];
+        SDL_Color c = {
+            (Uint8)((v1.color.r + v2.color.r + v3.color.r) / 3),
+            (Uint8)((v1.color.g + v2.color.g + v3.color.g) / 3),
+            (Uint8)((v1.color.b + v2.color.b + v3.color.b) / 3),
+            (Uint8)((v1.color.a + v2.color.a + v3.color.a) / 3),
+        };
+        fill_tri_fixed(c,
+            fixed(v1.position.x), fixed(v1.position.y),
+            fixed(v2.position.x), fixed(v2.position.y),
+            fixed(v3.position.x), fixed(v3.position.y));
+    }
+}
+
+void Context::flush_geometry(Batch& b)
+{
+    render_geometry()(renderer, b.texture >= 0 ? textures[b.texture] : NULL,
+        b.vertices.data(), (int)b.vertices.size(), b.indices.data(), (int)b.indices.size());
+}
+
+/**
+ * A batch of draw_image calls on one page as a single quad list, the tint
+ * going into the vertex colors. Without SDL_RenderGeometry each image is
+ * copied on its own.
+ */
+void Context::flush_images(Batch& b)
+{
+    SDL_Texture *page = textures[b.texture];
+    if (!has_geometry()) {
+        SDL_SetTextureColorMod(page, b.color.r, b.color.g, b.color.b);
+        SDL_SetTextureAlphaMod(page, b.color.a);
+        for (size_t j = 0; j < b.rects.size(); j++)
+            SDL_RenderCopy(renderer, page, &b.srcs[j], &b.rects[j]);
+        return;
+    }
+
+    // the page may still carry the tint of an immediate draw_image
+    SDL_SetTextureColorMod(page, 255, 255, 255);
+    SDL_SetTextureAlphaMod(page, 255);
+    int page_w, page_h;
+    SDL_QueryTexture(page, NULL, NULL, &page_w, &page_h);
+    for (size_t j = 0; j < b.rects.size(); j++)
+        push_quad(b.vertices, b.indices, b.rects[j], b.srcs[j], page_w, page_h, b.color);
+    render_geometry()(renderer, page, b.vertices.data(), (int)b.vertices.size(), b.indices.data(), (int)b.indices.size());
+}
+
+} // pse
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "colors.hpp"
+#include "ctx.hpp"
+
+namespace pse {
+
+/**
+ * Software backend: every primitive writes straight into the 32-bit ARGB
+ * pixel buffer owned by the context, which is uploaded through one streaming
+ * texture per frame by soft_present.
+ */
+
+static inline uint32_t blend(uint32_t dst, uint32_t src)
+{
+    uint32_t a = src >> 24;
+    if (a == 255) return src;
+    if (a == 0) return dst;
+    uint32_t rb = ((src & 0xff00ff) * a + (dst & 0xff00ff) * (255 - a)) >> 8;
+    uint32_t g = ((src & 0x00ff00) * a + (dst & 0x00ff00) * (255 - a)) >> 8;
+    return 0xff000000 | (rb & 0xff00ff) | (g & 0x00ff00);
+}
+
+static inline uint32_t modulate(uint32_t src, SDL_Color c)
+{
+    uint32_t a = ((src >> 24) * c.a + 255) >> 8;
+    uint32_t r = ((src >> 16 & 0xff) * c.r + 255) >> 8;
+    uint32_t g = ((src >> 8 & 0xff) * c.g + 255) >> 8;
+    uint32_t b = ((src & 0xff) * c.b + 255) >> 8;
+    return a << 24 | r << 16 | g << 8 | b;
+}
+
+bool Context::is_software()
+{
+    return context_flags & PSE_CONTEXT_SOFTWARE;
+}
+
+void Context::set_framebuffer(int w, int h)
+{
+    if (framebuffer)
+        SDL_DestroyTexture(framebuffer);
+
+    framebuffer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+    if (!framebuffer) {
+        fprintf(stderr, "Error: Failed to initialize framebuffer texture: %s\n", SDL_GetError());
+        exit(-1);
+    }
+    pixels.assign((size_t)w * h, 0);
+}
+
+void Context::soft_span(uint32_t color, int x1, int x2, int y)
+{
+    if (y < 0 || y >= screen_height) return;
+    x1 = std::max(x1, 0);
+    x2 = std::min(x2, screen_width - 1);
+    if (x1 > x2) return;
+    uint32_t *row = &pixels[(size_t)y * screen_width];
+    std::fill(row + x1, row + x2 + 1, color);
+}
+
+void Context::soft_clear(SDL_Color c)
+{
+    std::fill(pixels.begin(), pixels.end(), argb(c));
+}
+
+void Context::soft_points(SDL_Color c, const SDL_Point *points, int count)
+{
+    uint32_t color = argb(c);
+    for (int i = 0; i < count; i++) {
+        if ((unsigned)points[i].x < (unsigned)screen_width && (unsigned)points[i].y < (unsigned)screen_height)
+            pixels[(size_t)points[i].y * screen_width + points[i].x] = color;
+    }
+}
+
+void Context::soft_lines(SDL_Color c, const SDL_Point *segments, int count)
+{
+    uint32_t color = argb(c);
+    for (int i = 0; i < count; i++) {
+        int x0 = segments[i * 2].x, y0 = segments[i * 2].y;
+        int x1 = segments[i * 2 + 1].x, y1 = segments[i * 2 + 1].y;
+
+        if (y0 == y1) {
+            soft_span(color, std::min(x0, x1), std::max(x0, x1), y0);
+            continue;
+        }
+
+        // bresenham, bounds checked only when an end point is off screen
+        bool inside = (unsigned)x0 < (unsigned)screen_width && (unsigned)y0 < (unsigned)screen_height
+                   && (unsigned)x1 < (unsigned)screen_width && (unsigned)y1 < (unsigned)screen_height;
+        int dx = std::abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        int dy = -std::abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int error = dx + dy;
+        for (;;) {
+            if (inside || ((unsigned)x0 < (unsigned)screen_width && (unsigned)y0 < (unsigned)screen_height))
+                pixels[(size_t)y0 * screen_width + x0] = color;
+            if (x0 == x1 && y0 == y1) break;
+            int e2 = 2 * error;
+            if (e2 >= dy) { error += dy; x0 += sx; }
+            if (e2 <= dx) { error += dx; y0 += sy; }
+        }
+    }
+}
+
+void Context::soft_rects(SDL_Color c, const SDL_Rect *rects, int count, bool fill)
+{
+    uint32_t color = argb(c);
+    for (int i = 0; i < count; i++) {
+        const SDL_Rect& r = rects[i];
+        if (r.w <= 0 || r.h <= 0) continue;
+        int x2 = r.x + r.w - 1;
+        int y2 = r.y + r.h - 1;
+        if (fill) {
+            int y1 = std::max(r.y, 0);
+            y2 = std::min(y2, screen_height - 1);
+            for (int y = y1; y <= y2; y++)
+                soft_span(color, r.x, x2, y);
+            continue;
+        }
+        soft_span(color, r.x, x2, r.y);
+        soft_span(color, r.x, x2, y2);
+        for (int y = std::max(r.y + 1, 0); y < std::min(y2, screen_height); y++) {
+            if ((unsigned)r.x < (unsigned)screen_width)
+                pixels[(size_t)y * screen_width + r.x] = color;
+            if ((unsigned)x2 < (unsigned)screen_width)
+                pixels[(size_t)y * screen_width + x2] = color;
+        }
+    }
+}
+
+void Context::soft_image(int id, SDL_Rect rect, SDL_Color tint)
+{
+    SDL_Surface *s = surfaces[id];
+    if (rect.w <= 0 || rect.h <= 0) return;
+
+    // nearest neighbor scaling in 16.16 fixed point
+    int step_x = (s->w << 16) / rect.w;
+    int step_y = (s->h << 16) / rect.h;
+    int x1 = std::max(rect.x, 0), x2 = std::min(rect.x + rect.w, screen_width);
+    int y1 = std::max(rect.y, 0), y2 = std::min(rect.y + rect.h, screen_height);
+
+    bool tinted = (tint.r & tint.g & tint.b & tint.a) != 255;
+
+    for (int y = y1; y < y2; y++) {
+        const uint32_t *src = (const uint32_t *)((const uint8_t *)s->pixels + ((y - rect.y) * step_y >> 16) * s->pitch);
+        uint32_t *dst = &pixels[(size_t)y * screen_width];
+        int u = (x1 - rect.x) * step_x;
+        if (tinted) {
+            for (int x = x1; x < x2; x++, u += step_x)
+                dst[x] = blend(dst[x], modulate(src[u >> 16], tint));
+        }
+        else {
+            for (int x = x1; x < x2; x++, u += step_x)
+                dst[x] = blend(dst[x], src[u >> 16]);
+        }
+    }
+}
+
+void Context::soft_pixels(const uint32_t *argb, int w, int h)
+{
+    if (w == screen_width && h == screen_height) {
+        std::copy(argb, argb + (size_t)w * h, pixels.begin());
+        return;
+    }
+
+    // nearest neighbor scaling in 16.16 fixed point
+    int step_x = (w << 16) / screen_width;
+    int step_y = (h << 16) / screen_height;
+    for (int y = 0; y < screen_height; y++) {
+        const uint32_t *src = argb + (size_t)(y * step_y >> 16) * w;
+        uint32_t *dst = &pixels[(size_t)y * screen_width];
+        int u = 0;
+        for (int x = 0; x < screen_width; x++, u += step_x)
+            dst[x] = src[u >> 16];
+    }
+}
+
+void Context::soft_present()
+{
+    SDL_UpdateTexture(framebuffer, NULL, pixels.data(), screen_width * (int)sizeof(uint32_t));
+    SDL_RenderCopy(renderer, framebuffer, NULL, NULL);
+}
+
+} // pse
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "frame_stats.hpp"
+
+namespace pse {
+
+void FrameStats::record(FramePhase phase, double us)
+{
+    current[phase] = us;
+}
+
+void FrameStats::next_frame()
+{
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        samples[i][head] = current[i];
+        current[i] = 0.0;
+    }
+    head = (head + 1) % PSE_FRAME_STATS_SIZE;
+    if (count < PSE_FRAME_STATS_SIZE)
+        count++;
+}
+
+size_t FrameStats::size()
+{
+    return count;
+}
+
+double FrameStats::percentile(FramePhase phase, double p)
+{
+    if (count == 0)
+        return 0.0;
+
+    // order only the kept frames, the ring is not in time order once full
+    double sorted[PSE_FRAME_STATS_SIZE];
+    std::copy(samples[phase], samples[phase] + count, sorted);
+
+    // nearest rank
+    size_t rank = (size_t)std::ceil(p / 100.0 * count);
+    rank = std::min(std::max(rank, (size_t)1), count) - 1;
+    std::nth_element(sorted, sorted + rank, sorted + count);
+    return sorted[rank];
+}
+
+double FrameStats::p50(FramePhase phase)
+{
+    return percentile(phase, 50.0);
+}
+
+double FrameStats::p95(FramePhase phase)
+{
+    return percentile(phase, 95.0);
+}
+
+double FrameStats::p99(FramePhase phase)
+{
+    return percentile(phase, 99.0);
+}
+
+double FrameStats::max(FramePhase phase)
+{
+    if (count == 0)
+        return 0.0;
+    return *std::max_element(samples[phase], samples[phase] + count);
+}
+
+bool FrameStats::dump_csv(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Could not write frame stats: '%s'\n", path);
+        return false;
+    }
+
+    fprintf(f, "phase,frames,p50_us,p95_us,p99_us,max_us\n");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        FramePhase phase = (FramePhase)i;
+        fprintf(f, "%s,%zu,%.1f,%.1f,%.1f,%.1f\n", phase_name(phase), count,
+            p50(phase), p95(phase), p99(phase), max(phase));
+    }
+
+    fclose(f);
+    return true;
+}
+
+const char *FrameStats::phase_name(FramePhase phase)
+{
+    switch (phase) {
+    case PHASE_EVENTS:  return "events";
+    case PHASE_UPDATE:  return "update";
+    case PHASE_PRESENT: return "present";
+    case PHASE_SLEEP:   return "sleep";
+    case PHASE_FRAME:   return "frame";
+    default:            return "unknown";
+    }
+}
+
+} // pse
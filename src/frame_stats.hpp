@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+
+namespace pse {
+
+// number of frames kept for each phase
+#define PSE_FRAME_STATS_SIZE 1024
+
+enum FramePhase {
+    PHASE_EVENTS,  // event pump and input state
+    PHASE_UPDATE,  // clear and module update
+    PHASE_PRESENT, // SDL_RenderPresent
+    PHASE_SLEEP,   // frame pacing sleep
+    PHASE_FRAME,   // entire frame, including sleep
+    PHASE_COUNT,
+};
+
+class FrameStats {
+private:
+    // ring buffer of phase durations in microseconds
+    double samples[PHASE_COUNT][PSE_FRAME_STATS_SIZE] = {{0}};
+    double current[PHASE_COUNT] = {0};
+    size_t head = 0;
+    size_t count = 0;
+public:
+    void record(FramePhase phase, double us); // set the duration of a phase this frame
+    void next_frame(); // commit this frame's phases to the ring buffer
+    size_t size();
+
+    double percentile(FramePhase phase, double p); // p in [0, 100]
+    double p50(FramePhase phase);
+    double p95(FramePhase phase);
+    double p99(FramePhase phase);
+    double max(FramePhase phase);
+
+    bool dump_csv(const char *path); // write per phase p50/p95/p99/max, false on failure
+    static const char *phase_name(FramePhase phase);
+};
+
+} // pse
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include "pse-modules/modules.hpp"
@@ -7,7 +8,20 @@
 
 int main(int argc, char **argv)
 {
-    auto ctx = pse::Context("PSE", PSE_RESOLUTION_43_1024_768, 60);
+    unsigned int flags = PSE_CONTEXT_DEFAULT;
+    if (arg_check(argc, argv, "--headless"))
+        flags |= PSE_CONTEXT_HEADLESS;
+    if (arg_check(argc, argv, "--batched"))
+        flags |= PSE_CONTEXT_BATCHED;
+    if (arg_check(argc, argv, "--software"))
+        flags |= PSE_CONTEXT_SOFTWARE;
+
+    auto ctx = pse::Context("PSE", PSE_RESOLUTION_43_1024_768, 60, flags);
+
+    char *frames = arg_get(argc, argv, "--frames");
+    if (frames)
+        ctx.frame_limit = strtoul(frames, NULL, 10);
+    ctx.stats_path = arg_get(argc, argv, "--stats");
 
     if (arg_check(argc, argv, "--demo")) {
         ctx.run(Modules::demo_setup, Modules::demo_update);
@@ -22,7 +36,12 @@ int main(int argc, char **argv)
         ctx.run(Modules::mil_setup, Modules::mil_update);
     }*/
     else {
-        printf("Usage:\n--demo\n--rogue\n--trace\n");
+        printf("Usage:\n--demo\n--rogue\n--trace\n"
+               "Options:\n--headless    render offscreen without a window\n"
+               "--batched     record draw calls and submit them merged by color/texture\n"
+               "--software    draw into a CPU pixel buffer uploaded once per frame\n"
+               "--frames N    quit after N frames\n"
+               "--stats FILE  write frame phase timings to a CSV file on exit\n");
     }
 
     return 0;
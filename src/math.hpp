@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PSE_MATH_SSE
+#endif
+
+namespace pse {
+namespace math {
+
+/**
+ * 4 wide float vectors and 4x4 matrices. Vectors are rows and are multiplied
+ * on the left of matrices, so transforms chain left to right: v * world * view.
+ * Storage is plain floats so everything can be constexpr, the SSE paths load
+ * and store them aligned. Define PSE_MATH_SCALAR to force the scalar paths.
+ */
+
+#ifdef PSE_MATH_SCALAR
+#undef PSE_MATH_SSE
+#endif
+
+struct alignas(16) Vec4 {
+    float x, y, z, w;
+
+    constexpr Vec4() : x(0), y(0), z(0), w(0) {}
+    constexpr Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+
+#ifdef PSE_MATH_SSE
+    Vec4(__m128 v) { _mm_store_ps(&x, v); }
+    __m128 simd() const { return _mm_load_ps(&x); }
+#endif
+
+    constexpr float operator[](int i) const { return i == 0 ? x : i == 1 ? y : i == 2 ? z : w; }
+};
+
+// w = 1 is translated by matrices, w = 0 is not
+constexpr Vec4 point(float x, float y, float z) { return Vec4{ x, y, z, 1 }; }
+constexpr Vec4 direction(float x, float y, float z) { return Vec4{ x, y, z, 0 }; }
+
+inline Vec4 operator+(const Vec4& a, const Vec4& b)
+{
+#ifdef PSE_MATH_SSE
+    return _mm_add_ps(a.simd(), b.simd());
+#else
+    return Vec4{ a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w };
+#endif
+}
+
+inline Vec4 operator-(const Vec4& a, const Vec4& b)
+{
+#ifdef PSE_MATH_SSE
+    return _mm_sub_ps(a.simd(), b.simd());
+#else
+    return Vec4{ a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w };
+#endif
+}
+
+inline Vec4 operator*(const Vec4& v, float k)
+{
+#ifdef PSE_MATH_SSE
+    return _mm_mul_ps(v.simd(), _mm_set1_ps(k));
+#else
+    return Vec4{ v.x * k, v.y * k, v.z * k, v.w * k };
+#endif
+}
+
+inline Vec4 operator*(float k, const Vec4& v) { return v * k; }
+
+inline Vec4 operator/(const Vec4& v, float k)
+{
+#ifdef PSE_MATH_SSE
+    return _mm_div_ps(v.simd(), _mm_set1_ps(k));
+#else
+    return Vec4{ v.x / k, v.y / k, v.z / k, v.w / k };
+#endif
+}
+
+constexpr Vec4 operator-(const Vec4& v) { return Vec4{ -v.x, -v.y, -v.z, -v.w }; }
+
+inline Vec4& operator+=(Vec4& a, const Vec4& b) { return a = a + b; }
+inline Vec4& operator-=(Vec4& a, const Vec4& b) { return a = a - b; }
+inline Vec4& operator*=(Vec4& v, float k) { return v = v * k; }
+inline Vec4& operator/=(Vec4& v, float k) { return v = v / k; }
+
+// xyz only, w is ignored
+constexpr float dot(const Vec4& a, const Vec4& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+// xyz cross product, w of the result is 0
+constexpr Vec4 cross(const Vec4& a, const Vec4& b)
+{
+    return Vec4{
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x,
+        0,
+    };
+}
+
+inline float length(const Vec4& v) { return std::sqrt(dot(v, v)); }
+
+// unit length xyz, w is kept
+inline Vec4 normalize(const Vec4& v)
+{
+    float k = 1.0f / length(v);
+    return Vec4{ v.x * k, v.y * k, v.z * k, v.w };
+}
+
+inline float distance(const Vec4& a, const Vec4& b) { return length(a - b); }
+
+struct alignas(16) Mat4 {
+    Vec4 r[4]; // rows
+
+    constexpr Mat4() : r{} {}
+    constexpr Mat4(const Vec4& r0, const Vec4& r1, const Vec4& r2, const Vec4& r3) : r{ r0, r1, r2, r3 } {}
+    constexpr Mat4(
+        float _00, float _01, float _02, float _03,
+        float _10, float _11, float _12, float _13,
+        float _20, float _21, float _22, float _23,
+        float _30, float _31, float _32, float _33
+    ) : r{
+        { _00, _01, _02, _03 },
+        { _10, _11, _12, _13 },
+        { _20, _21, _22, _23 },
+        { _30, _31, _32, _33 },
+    } {}
+
+    constexpr const Vec4& operator[](int i) const { return r[i]; }
+    Vec4& operator[](int i) { return r[i]; }
+
+    static constexpr Mat4 identity() {
+        return Mat4{
+            1, 0, 0, 0,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+            0, 0, 0, 1,
+        };
+    }
+
+    static constexpr Mat4 translate(float x, float y, float z) {
+        return Mat4{
+            1, 0, 0, 0,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+            x, y, z, 1,
+        };
+    }
+
+    static Mat4 rotate_x(float radians) {
+        float c = std::cos(radians), s = std::sin(radians);
+        return Mat4{
+            1,  0, 0, 0,
+            0,  c, s, 0,
+            0, -s, c, 0,
+            0,  0, 0, 1,
+        };
+    }
+
+    static Mat4 rotate_y(float radians) {
+        float c = std::cos(radians), s = std::sin(radians);
+        return Mat4{
+            c, 0, s, 0,
+            0, 1, 0, 0,
+           -s, 0, c, 0,
+            0, 0, 0, 1,
+        };
+    }
+
+    static Mat4 rotate_z(float radians) {
+        float c = std::cos(radians), s = std::sin(radians);
+        return Mat4{
+            c, s, 0, 0,
+           -s, c, 0, 0,
+            0, 0, 1, 0,
+            0, 0, 0, 1,
+        };
+    }
+
+    // left handed perspective, fov in degrees, aspect ratio is height / width
+    static Mat4 project(float fov, float aspect_ratio, float near, float far) {
+        float f = 1.0f / std::tan(fov * 0.5f * 3.14159265f / 180.0f);
+        return Mat4{
+            aspect_ratio * f, 0, 0,                            0,
+            0,                f, 0,                            0,
+            0,                0, far / (far - near),           1,
+            0,                0, -far * near / (far - near),   0,
+        };
+    }
+
+    // place an object at pos facing target, the camera matrix is its inverse
+    static Mat4 point_at(const Vec4& pos, const Vec4& target, const Vec4& up) {
+        Vec4 forward = normalize(target - pos);
+        Vec4 new_up = normalize(up - forward * dot(up, forward));
+        Vec4 right = cross(new_up, forward);
+        return Mat4{
+            right.x,   right.y,   right.z,   0,
+            new_up.x,  new_up.y,  new_up.z,  0,
+            forward.x, forward.y, forward.z, 0,
+            pos.x,     pos.y,     pos.z,     1,
+        };
+    }
+
+    // inverse of a rotation and translation only matrix
+    static Mat4 quick_inverse(const Mat4& m) {
+        const Vec4& t = m.r[3];
+        return Mat4{
+            m.r[0].x, m.r[1].x, m.r[2].x, 0,
+            m.r[0].y, m.r[1].y, m.r[2].y, 0,
+            m.r[0].z, m.r[1].z, m.r[2].z, 0,
+            -(t.x * m.r[0].x + t.y * m.r[0].y + t.z * m.r[0].z),
+            -(t.x * m.r[1].x + t.y * m.r[1].y + t.z * m.r[1].z),
+            -(t.x * m.r[2].x + t.y * m.r[2].y + t.z * m.r[2].z),
+            1,
+        };
+    }
+};
+
+// row vector times matrix
+inline Vec4 operator*(const Vec4& v, const Mat4& m)
+{
+#ifdef PSE_MATH_SSE
+    __m128 x = _mm_mul_ps(_mm_set1_ps(v.x), m.r[0].simd());
+    __m128 y = _mm_mul_ps(_mm_set1_ps(v.y), m.r[1].simd());
+    __m128 z = _mm_mul_ps(_mm_set1_ps(v.z), m.r[2].simd());
+    __m128 w = _mm_mul_ps(_mm_set1_ps(v.w), m.r[3].simd());
+    return _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w));
+#else
+    return Vec4{
+        v.x * m.r[0].x + v.y * m.r[1].x + v.z * m.r[2].x + v.w * m.r[3].x,
+        v.x * m.r[0].y + v.y * m.r[1].y + v.z * m.r[2].y + v.w * m.r[3].y,
+        v.x * m.r[0].z + v.y * m.r[1].z + v.z * m.r[2].z + v.w * m.r[3].z,
+        v.x * m.r[0].w + v.y * m.r[1].w + v.z * m.r[2].w + v.w * m.r[3].w,
+    };
+#endif
+}
+
+inline Vec4& operator*=(Vec4& v, const Mat4& m) { return v = v * m; }
+
+// a then b, each row of a transformed by b
+inline Mat4 operator*(const Mat4& a, const Mat4& b)
+{
+    return Mat4{ a.r[0] * b, a.r[1] * b, a.r[2] * b, a.r[3] * b };
+}
+
+inline Mat4& operator*=(Mat4& a, const Mat4& b) { return a = a * b; }
+
+constexpr Mat4 transpose(const Mat4& m)
+{
+    return Mat4{
+        m.r[0].x, m.r[1].x, m.r[2].x, m.r[3].x,
+        m.r[0].y, m.r[1].y, m.r[2].y, m.r[3].y,
+        m.r[0].z, m.r[1].z, m.r[2].z, m.r[3].z,
+        m.r[0].w, m.r[1].w, m.r[2].w, m.r[3].w,
+    };
+}
+
+} // math
+} // pse
@@ -1,3 +1,5 @@
+#include <vector>
+
 #include "../../pse.hpp"
 
 #include "draw.hpp"
@@ -7,6 +9,9 @@
 
 namespace Modules {
 
+// sprites collected over a draw pass, submitted in one draw_images call
+static std::vector<pse::Sprite> Sprites;
+
 void load_sprites()
 {
     SpritePlayerId     = PSE_Context->load_image("src/pse-modules/rogue/textures/player.png");
@@ -91,21 +96,21 @@ void draw_graph_doors(int i, int j)
 
 void draw_map()
 {
+    Sprites.clear();
     for (int i = 0; i < MAP_SIZE; ++i) {
         for (int j = 0; j < MAP_SIZE; ++j) {
-            SDL_Color c;
             SDL_Rect tile = SDL_Rect{ j * TILE_WIDTH, i * TILE_WIDTH, TILE_WIDTH, TILE_WIDTH };
             switch (FLR.Map[i][j]) {
                 case WALL:
-                    PSE_Context->draw_image(SpriteWallId, tile);
+                    Sprites.push_back(pse::Sprite{ SpriteWallId, tile });
                     break;
                 case FLOOR:
                     if (Player.graph_x == map_to_graph_index(j) && Player.graph_y == map_to_graph_index(i))
-                        PSE_Context->draw_image(SpriteFloorLightId, tile);
+                        Sprites.push_back(pse::Sprite{ SpriteFloorLightId, tile });
                     else if (FLR.Graph[map_to_graph_index(i)][map_to_graph_index(j)].is_explored)
-                        PSE_Context->draw_image(SpriteFloorDarkId, tile);
+                        Sprites.push_back(pse::Sprite{ SpriteFloorDarkId, tile });
                     else
-                        PSE_Context->draw_image(SpriteWallId, tile);
+                        Sprites.push_back(pse::Sprite{ SpriteWallId, tile });
                     break;
                 case EMPTY:
                     PSE_Context->draw_rect_fill(pse::Black, tile);
@@ -115,11 +120,14 @@ void draw_map()
             }
         }
     }
+    // tiles never overlap, so drawing them after the fills changes nothing
+    PSE_Context->draw_images(Sprites.data(), (int)Sprites.size());
 }
 
 void draw_entities()
 {
     // traverse backwards, make first inserted displayed on top
+    Sprites.clear();
     for (int i = 0; i < EntityIndex; ++i) {
         if (!Entities[i]) {
             #ifdef DEBUG
@@ -129,33 +137,36 @@ void draw_entities()
         }
         
         SDL_Rect rect{ Entities[i]->map_x * TILE_WIDTH, Entities[i]->map_y * TILE_WIDTH, TILE_WIDTH, TILE_WIDTH };
-        SDL_Color c;
 
         switch (Entities[i]->id) {
             case ID_PLAYER:
-                PSE_Context->draw_image(SpritePlayerId, rect);
+                Sprites.push_back(pse::Sprite{ SpritePlayerId, rect });
                 break;
             case ID_ENEMY:
                 if (!FLR.Graph[Entities[i]->graph_y][Entities[i]->graph_x].is_explored)
-                    PSE_Context->draw_image(SpriteWallId, rect);
+                    Sprites.push_back(pse::Sprite{ SpriteWallId, rect });
                 else if (coords_equal(Player.graph_x, Player.graph_y, Entities[i]->graph_x, Entities[i]->graph_y))
-                    PSE_Context->draw_image(SpriteEnemyId, rect);
+                    Sprites.push_back(pse::Sprite{ SpriteEnemyId, rect });
                 else
-                    PSE_Context->draw_image(SpriteFloorDarkId, rect);
+                    Sprites.push_back(pse::Sprite{ SpriteFloorDarkId, rect });
                 break;
             case ID_STAIR_DOWN:
                 if (FLR.Graph[FLR.StairDown.graph_y][FLR.StairDown.graph_x].is_explored)
-                    PSE_Context->draw_image(SpriteStairDownId, rect);
+                    Sprites.push_back(pse::Sprite{ SpriteStairDownId, rect });
                 else
-                    PSE_Context->draw_image(SpriteWallId, rect);
+                    Sprites.push_back(pse::Sprite{ SpriteWallId, rect });
                 break;
             case ID_STAIR_UP:
-                PSE_Context->draw_image(SpriteStairUpId, rect);
+                Sprites.push_back(pse::Sprite{ SpriteStairUpId, rect });
                 break;
             default:
+                // keep painter's order with the sprites before it
+                PSE_Context->draw_images(Sprites.data(), (int)Sprites.size());
+                Sprites.clear();
                 PSE_Context->draw_rect_fill(pse::Magenta, rect);
         }
     }
+    PSE_Context->draw_images(Sprites.data(), (int)Sprites.size());
 }
 
 }
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+#include "mesh.hpp"
+
+namespace trace {
+
+namespace {
+
+struct VecHash {
+    size_t operator()(const Vec4& v) const {
+        std::hash<float> h;
+        return h(v.x) ^ (h(v.y) * 31) ^ (h(v.z) * 961);
+    }
+};
+
+struct VecEqual {
+    bool operator()(const Vec4& v1, const Vec4& v2) const {
+        return v1.x == v2.x && v1.y == v2.y && v1.z == v2.z;
+    }
+};
+
+// a face vertex, 0 based, or relative to the start of its chunk when negative in the file
+struct Corner {
+    int32_t index;
+    bool relative;
+};
+
+// what one thread parsed from a range of whole lines
+struct Chunk {
+    const char* begin;
+    const char* end;
+    std::vector<Vec4> positions;
+    std::vector<Corner> corners;
+    std::vector<uint32_t> sizes; // corners of each face
+    std::vector<uint32_t> lines; // 0 based line of each face within the chunk
+    uint32_t line_count = 0;
+    uint32_t error_line = 0;
+    const char* error = nullptr;
+};
+
+inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skip_space(const char* p, const char* end)
+{
+    while (p < end && is_space(*p))
+        p++;
+    return p;
+}
+
+inline const char* skip_token(const char* p, const char* end)
+{
+    while (p < end && !is_space(*p))
+        p++;
+    return p;
+}
+
+bool parse_float(const char*& p, const char* end, float& out)
+{
+    p = skip_space(p, end);
+    // from_chars does not take a leading plus
+    if (p < end && *p == '+')
+        p++;
+    std::from_chars_result r = std::from_chars(p, end, out);
+    if (r.ec != std::errc() || (r.ptr < end && !is_space(*r.ptr)))
+        return false;
+    p = r.ptr;
+    return true;
+}
+
+// the position of a v, v/vt, v//vn or v/vt/vn face token
+bool parse_corner(const char*& p, const char* end, int32_t& out)
+{
+    std::from_chars_result r = std::from_chars(p, end, out);
+    if (r.ec != std::errc() || out == 0)
+        return false;
+    p = r.ptr;
+    // texture and normal indices are checked but not kept
+    for (int i = 0; i < 2 && p < end && *p == '/'; i++) {
+        p++;
+        if (p < end && (*p == '-' || (*p >= '0' && *p <= '9'))) {
+            int32_t skipped;
+            r = std::from_chars(p, end, skipped);
+            if (r.ec != std::errc())
+                return false;
+            p = r.ptr;
+        }
+    }
+    return p == end || is_space(*p);
+}
+
+void parse_line(Chunk& chunk, const char* p, const char* end)
+{
+    // comments run to the end of the line
+    const char* comment = (const char*)memchr(p, '#', end - p);
+    if (comment)
+        end = comment;
+
+    p = skip_space(p, end);
+    const char* keyword = p;
+    p = skip_token(p, end);
+    size_t length = p - keyword;
+
+    if (length == 1 && keyword[0] == 'v') {
+        Vec4 v = point(0, 0, 0);
+        if (!parse_float(p, end, v.x) || !parse_float(p, end, v.y) || !parse_float(p, end, v.z)) {
+            chunk.error = "expected 3 numbers after v";
+            return;
+        }
+        // an optional w is ignored
+        chunk.positions.push_back(v);
+    }
+    else if (length == 1 && keyword[0] == 'f') {
+        uint32_t count = 0;
+        for (p = skip_space(p, end); p < end; p = skip_space(p, end)) {
+            int32_t index;
+            if (!parse_corner(p, end, index)) {
+                chunk.error = "invalid face vertex";
+                return;
+            }
+            if (index > 0)
+                chunk.corners.push_back(Corner{ index - 1, false });
+            else
+                chunk.corners.push_back(Corner{ (int32_t)chunk.positions.size() + index, true });
+            count++;
+        }
+        if (count < 3) {
+            chunk.error = "face needs at least 3 vertices";
+            return;
+        }
+        chunk.sizes.push_back(count);
+        chunk.lines.push_back(chunk.line_count);
+    }
+    // vt, vn, groups, materials and the rest do not affect the mesh
+}
+
+void parse_chunk(Chunk& chunk)
+{
+    for (const char* p = chunk.begin; p < chunk.end; chunk.line_count++) {
+        const char* eol = (const char*)memchr(p, '\n', chunk.end - p);
+        if (!eol)
+            eol = chunk.end;
+        parse_line(chunk, p, eol);
+        if (chunk.error) {
+            chunk.error_line = chunk.line_count;
+            return;
+        }
+        p = eol + 1;
+    }
+}
+
+} // namespace
+
+// FNV-1a over 8 byte words, then the tail bytes
+static uint64_t hash_bytes(const char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ (uint8_t)data[i]) * 1099511628211ull;
+    return hash;
+}
+
+// name.obj caches to name.mesh, and its simplified levels to name.lod1.mesh on
+static std::string cache_path_of(const char* path, int level)
+{
+    std::string cache_path = path;
+    size_t dot = cache_path.rfind('.');
+    size_t slash = cache_path.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        cache_path.resize(dot);
+    if (level > 0)
+        cache_path += ".lod" + std::to_string(level);
+    return cache_path + ".mesh";
+}
+
+void Mesh::load(const char* path, Workers& workers)
+{
+    pse::MappedFile text(path, pse::MappedFile::ACCESS_SEQUENTIAL);
+    if (!text.is_open()) {
+        fprintf(stderr, "Error: Failed to read mesh '%s'\n", path);
+        exit(-1);
+    }
+
+    std::string cache_path = cache_path_of(path, 0);
+    this->source_size = text.size();
+    this->source_hash = hash_bytes(text.data(), text.size());
+    if (this->load_cache(cache_path, this->source_size, this->source_hash))
+        return;
+    this->parse(path, text.data(), text.size(), workers);
+    this->save_cache(cache_path, this->source_size, this->source_hash);
+}
+
+void Mesh::load_simplified(const char* path, int level, const Mesh& source, size_t face_count)
+{
+    // keyed by the whole chain, as each level is simplified from the last
+    std::string cache_path = cache_path_of(path, level);
+    this->source_size = source.source_size;
+    this->source_hash = (source.source_hash ^ face_count) * 1099511628211ull;
+    if (this->load_cache(cache_path, this->source_size, this->source_hash))
+        return;
+    this->simplify(source, face_count);
+    this->save_cache(cache_path, this->source_size, this->source_hash);
+}
+
+void Mesh::parse(const char* path, const char* text, size_t size, Workers& workers)
+{
+    // split at line boundaries, small files are not worth the threads
+    const char* begin = text;
+    const char* end = begin + size;
+    size_t count = std::min<size_t>(workers.size(), size / MESH_CHUNK_BYTES + 1);
+    std::vector<Chunk> chunks(count);
+    for (size_t i = 0; i < count; i++) {
+        chunks[i].begin = i == 0 ? begin : chunks[i - 1].end;
+        chunks[i].end = end;
+        if (i + 1 < count) {
+            const char* split = begin + size * (i + 1) / count;
+            if (split < chunks[i].begin)
+                split = chunks[i].begin;
+            const char* eol = (const char*)memchr(split, '\n', end - split);
+            chunks[i].end = eol ? eol + 1 : end;
+        }
+    }
+    workers.run([&](unsigned thread) {
+        if (thread < chunks.size())
+            parse_chunk(chunks[thread]);
+    });
+
+    // *.obj positions may repeat, each maps to its first occurrence
+    std::vector<uint32_t> remap;
+    std::unordered_map<Vec4, uint32_t, VecHash, VecEqual> unique;
+    size_t line = 0;
+    for (Chunk& chunk : chunks) {
+        if (chunk.error) {
+            fprintf(stderr, "Error: %s:%zu: %s\n", path, line + chunk.error_line + 1, chunk.error);
+            exit(-1);
+        }
+        for (const Vec4& v : chunk.positions) {
+            auto found = unique.emplace(v, (uint32_t)this->own_vertices.size());
+            if (found.second)
+                this->own_vertices.push_back(v);
+            remap.push_back(found.first->second);
+        }
+        line += chunk.line_count;
+    }
+
+    // faces may name any position in the file, so resolve them once all are known
+    size_t vertex_base = 0;
+    line = 0;
+    for (Chunk& chunk : chunks) {
+        const Corner* corner = chunk.corners.data();
+        for (size_t f = 0; f < chunk.sizes.size(); f++) {
+            uint32_t resolved[2];
+            for (uint32_t k = 0; k < chunk.sizes[f]; k++, corner++) {
+                int64_t index = corner->relative ? (int64_t)vertex_base + corner->index : corner->index;
+                if (index < 0 || index >= (int64_t)remap.size()) {
+                    fprintf(stderr, "Error: %s:%zu: face vertex out of range\n", path, line + chunk.lines[f] + 1);
+                    exit(-1);
+                }
+                // fan around the first corner
+                uint32_t v = remap[index];
+                if (k == 0) {
+                    resolved[0] = v;
+                }
+                else if (k >= 2) {
+                    this->own_indices.push_back(resolved[0]);
+                    this->own_indices.push_back(resolved[1]);
+                    this->own_indices.push_back(v);
+                }
+                resolved[1] = v;
+            }
+        }
+        vertex_base += chunk.positions.size();
+        line += chunk.line_count;
+    }
+
+    this->build();
+}
+
+void Mesh::build()
+{
+    this->build_meshlets();
+
+    this->own_positions.resize(this->own_vertices.size());
+    this->bounds_min = this->bounds_max = this->own_vertices.empty() ? point(0, 0, 0) : this->own_vertices[0];
+    for (size_t i = 0; i < this->own_vertices.size(); i++) {
+        const Vec4& v = this->own_vertices[i];
+        this->own_positions.x[i] = v.x;
+        this->own_positions.y[i] = v.y;
+        this->own_positions.z[i] = v.z;
+        this->own_positions.w[i] = 1.0f;
+        this->bounds_min = point(std::min(this->bounds_min.x, v.x), std::min(this->bounds_min.y, v.y), std::min(this->bounds_min.z, v.z));
+        this->bounds_max = point(std::max(this->bounds_max.x, v.x), std::max(this->bounds_max.y, v.y), std::max(this->bounds_max.z, v.z));
+    }
+
+    size_t faces = this->own_indices.size() / 3;
+    this->own_normals.resize(faces);
+    for (size_t f = 0; f < faces; f++) {
+        const Vec4& p0 = this->own_vertices[this->own_indices[f * 3]];
+        const Vec4& p1 = this->own_vertices[this->own_indices[f * 3 + 1]];
+        const Vec4& p2 = this->own_vertices[this->own_indices[f * 3 + 2]];
+        this->own_normals[f] = normalize(cross(p1 - p0, p2 - p0));
+    }
+    this->bound_meshlets();
+
+    this->vertices = Span<Vec4>{ this->own_vertices.data(), this->own_vertices.size() };
+    this->positions = this->own_positions.view();
+    this->indices = Span<uint32_t>{ this->own_indices.data(), this->own_indices.size() };
+    this->normals = Span<Vec4>{ this->own_normals.data(), this->own_normals.size() };
+    this->meshlets = Span<Meshlet>{ this->own_meshlets.data(), this->own_meshlets.size() };
+}
+
+} // trace
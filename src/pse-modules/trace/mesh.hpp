@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pipeline.hpp"
+#include "types.hpp"
+#include "workers.hpp"
+
+namespace trace {
+
+// *.obj bytes per parsing thread, smaller files are parsed on one
+#define MESH_CHUNK_BYTES (256 * 1024)
+
+// bump whenever the binary cache layout or what is stored in it changes
+#define MESH_CACHE_VERSION 3
+
+// most faces in a meshlet
+#define MESH_MESHLET_FACES 64
+
+/**
+ * A cluster of neighbouring faces with vertices of its own, so it can be
+ * culled as a whole before any of it is transformed. The bounding sphere
+ * holds the vertices and every face normal lies within the normal cone.
+ */
+struct Meshlet {
+    uint32_t vertex_begin; // a multiple of PIPELINE_LANES
+    uint32_t vertex_count; // padded to PIPELINE_LANES by repeating the last
+    uint32_t face_begin;
+    uint32_t face_count;
+    Vec4 center;
+    Vec4 cone_axis;  // unit length, w = 0
+    float radius;
+    float cone_cos;  // of the half angle of the cone, 0 or less when too wide to cull by
+    float cone_sin;
+};
+
+/**
+ * Indexed triangle mesh split into meshlets: faces are grouped by meshlet and
+ * refer by index to the positions of their meshlet, with per face data kept
+ * in parallel arrays. The arrays are views into either storage owned by the
+ * mesh, after parsing a *.obj, or a mapped binary cache of it, see
+ * mesh_cache.cpp.
+ */
+struct Mesh {
+    Span<Vec4> vertices;    // positions by meshlet, shared ones repeated in each, w = 1
+    StreamView positions;   // the same positions as a stream for the kernels
+    Span<uint32_t> indices; // 3 per face into vertices
+    Span<Vec4> normals;     // per face, unit length, w = 0
+    Span<Meshlet> meshlets;
+    Vec4 bounds_min;        // box around the positions
+    Vec4 bounds_max;
+    float error = 0;        // how far simplifying may have moved the surface, 0 when loaded
+
+    Mesh() {}
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    size_t face_count() const {
+        return indices.size / 3;
+    }
+
+    // v and f lines of a *.obj, faces of any size are fanned into triangles,
+    // errors are reported with their line and exit. The binary cache next to
+    // it is used instead while it matches the file, and written when it does not
+    void load(const char* path, Workers& workers);
+
+    // source reduced to at most face_count faces by quadric error edge
+    // collapse, see mesh_simplify.cpp. Stops early when nothing more can be
+    // collapsed without folding a face over
+    void simplify(const Mesh& source, size_t face_count);
+
+    // simplify, through a cache of its own next to that of the *.obj at path
+    // the chain of levels came from, so each level is only simplified again
+    // when the file or the face counts of the levels before it change
+    void load_simplified(const char* path, int level, const Mesh& source, size_t face_count);
+
+private:
+    // storage when parsed
+    std::vector<Vec4> own_vertices;
+    Stream own_positions;
+    std::vector<uint32_t> own_indices;
+    std::vector<Vec4> own_normals;
+    std::vector<Meshlet> own_meshlets;
+
+    // the cache file when loaded from one, and what it was built from
+    pse::MappedFile cache;
+    uint64_t source_size = 0;
+    uint64_t source_hash = 0;
+
+    void parse(const char* path, const char* text, size_t size, Workers& workers);
+    // regroup own_vertices and own_indices by meshlet, then fill in
+    // everything else and the views from them, see mesh_meshlets.cpp
+    void build();
+    void build_meshlets();
+    void bound_meshlets();
+    bool load_cache(const std::string& cache_path, uint64_t source_size, uint64_t source_hash);
+    void save_cache(const std::string& cache_path, uint64_t source_size, uint64_t source_hash) const;
+};
+
+} // trace
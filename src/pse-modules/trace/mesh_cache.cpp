@@ -0,0 +1,190 @@
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "mesh.hpp"
+
+namespace trace {
+
+/**
+ * Binary mesh cache: a header, then the arrays of Mesh exactly as they sit in
+ * memory, each starting on a cache line. Loading maps the file with
+ * pse::MappedFile and points the mesh views into it, so nothing is parsed or
+ * copied, only the indices and meshlet ranges are checked once. It is native
+ * endian and only meant to be rebuilt on the machine that uses it.
+ */
+
+namespace {
+
+struct CacheHeader {
+    char magic[4];        // "PSEM"
+    uint32_t version;     // MESH_CACHE_VERSION
+    uint64_t source_size; // of the *.obj it was built from
+    uint64_t source_hash;
+    uint32_t vertex_count;
+    uint32_t face_count;
+    uint32_t meshlet_count;
+    float bounds_min[3];
+    float bounds_max[3];
+    float error;          // Mesh::error, for simplified levels
+};
+
+// byte offsets of every array, the same for writing and reading
+struct CacheLayout {
+    size_t vertices;
+    size_t x, y, z, w; // positions, each padded to PIPELINE_LANES
+    size_t indices;
+    size_t normals;
+    size_t meshlets;
+    size_t total;
+
+    CacheLayout(size_t vertex_count, size_t face_count, size_t meshlet_count) {
+        size_t lanes = (vertex_count + PIPELINE_LANES - 1) / PIPELINE_LANES * PIPELINE_LANES;
+        size_t at = 0;
+        auto place = [&at](size_t bytes) {
+            at = (at + 63) / 64 * 64;
+            size_t offset = at;
+            at += bytes;
+            return offset;
+        };
+        place(sizeof(CacheHeader));
+        this->vertices = place(vertex_count * sizeof(Vec4));
+        this->x = place(lanes * sizeof(float));
+        this->y = place(lanes * sizeof(float));
+        this->z = place(lanes * sizeof(float));
+        this->w = place(lanes * sizeof(float));
+        this->indices = place(face_count * 3 * sizeof(uint32_t));
+        this->normals = place(face_count * sizeof(Vec4));
+        this->meshlets = place(meshlet_count * sizeof(Meshlet));
+        this->total = at;
+    }
+};
+
+// writes the arrays front to back, zero padding up to each offset, so there
+// is no seeking and no long offset to overflow on files past 2 GB
+struct CacheWriter {
+    FILE* f;
+    size_t at = 0;
+
+    bool write_at(size_t offset, const void* data, size_t bytes) {
+        static const char zeros[64] = {};
+        if (offset < this->at || offset - this->at > sizeof(zeros))
+            return false;
+        if (fwrite(zeros, 1, offset - this->at, this->f) != offset - this->at
+            || fwrite(data, 1, bytes, this->f) != bytes)
+            return false;
+        this->at = offset + bytes;
+        return true;
+    }
+};
+
+// the meshlets have to tile the faces and vertices in order, the way
+// build_meshlets lays them out, and every face may only refer to vertices of
+// its own meshlet, which are all the kernels transform for it. Anything else
+// is a damaged or foreign file, and drawing from it would read out of bounds
+bool valid_payload(const CacheHeader& header, const uint32_t* indices, const Meshlet* meshlets)
+{
+    uint32_t face = 0, vertex = 0;
+    for (uint32_t i = 0; i < header.meshlet_count; i++) {
+        const Meshlet& m = meshlets[i];
+        if (m.face_begin != face || m.vertex_begin != vertex
+            || m.face_count == 0 || m.face_count > MESH_MESHLET_FACES
+            || m.vertex_count == 0 || m.vertex_count % PIPELINE_LANES
+            || m.face_count > header.face_count - face
+            || m.vertex_count > header.vertex_count - vertex)
+            return false;
+        const uint32_t* index = indices + (size_t)m.face_begin * 3;
+        for (uint32_t k = 0; k < m.face_count * 3; k++) {
+            if (index[k] - m.vertex_begin >= m.vertex_count)
+                return false;
+        }
+        face += m.face_count;
+        vertex += m.vertex_count;
+    }
+    return face == header.face_count && vertex == header.vertex_count;
+}
+
+} // namespace
+
+bool Mesh::load_cache(const std::string& cache_path, uint64_t source_size, uint64_t source_hash)
+{
+    pse::MappedFile file(cache_path.c_str(), pse::MappedFile::ACCESS_RANDOM);
+    size_t size = file.size();
+    const char* base = file.data();
+    const CacheHeader* header = (const CacheHeader*)base;
+    bool valid = size >= sizeof(CacheHeader)
+        && memcmp(header->magic, "PSEM", 4) == 0
+        && header->version == MESH_CACHE_VERSION
+        && header->source_size == source_size
+        && header->source_hash == source_hash
+        && CacheLayout(header->vertex_count, header->face_count, header->meshlet_count).total == size;
+    if (!valid)
+        return false;
+
+    CacheLayout layout(header->vertex_count, header->face_count, header->meshlet_count);
+    if (!valid_payload(*header, (const uint32_t*)(base + layout.indices), (const Meshlet*)(base + layout.meshlets)))
+        return false;
+    this->vertices = Span<Vec4>{ (const Vec4*)(base + layout.vertices), header->vertex_count };
+    this->positions = StreamView{
+        (const float*)(base + layout.x),
+        (const float*)(base + layout.y),
+        (const float*)(base + layout.z),
+        (const float*)(base + layout.w),
+        header->vertex_count,
+    };
+    this->indices = Span<uint32_t>{ (const uint32_t*)(base + layout.indices), (size_t)header->face_count * 3 };
+    this->normals = Span<Vec4>{ (const Vec4*)(base + layout.normals), header->face_count };
+    this->meshlets = Span<Meshlet>{ (const Meshlet*)(base + layout.meshlets), header->meshlet_count };
+    this->bounds_min = point(header->bounds_min[0], header->bounds_min[1], header->bounds_min[2]);
+    this->bounds_max = point(header->bounds_max[0], header->bounds_max[1], header->bounds_max[2]);
+    this->error = header->error;
+    // the views stay valid, the mapping or buffer moves as is
+    this->cache = std::move(file);
+    return true;
+}
+
+void Mesh::save_cache(const std::string& cache_path, uint64_t source_size, uint64_t source_hash) const
+{
+    CacheHeader header = {};
+    memcpy(header.magic, "PSEM", 4);
+    header.version = MESH_CACHE_VERSION;
+    header.source_size = source_size;
+    header.source_hash = source_hash;
+    header.vertex_count = (uint32_t)this->vertices.size;
+    header.face_count = (uint32_t)this->face_count();
+    header.meshlet_count = (uint32_t)this->meshlets.size;
+    memcpy(header.bounds_min, &this->bounds_min.x, sizeof(header.bounds_min));
+    memcpy(header.bounds_max, &this->bounds_max.x, sizeof(header.bounds_max));
+    header.error = this->error;
+
+    // the meshlets end the file, without any faces there are none and it
+    // would be short of its layout
+    if (header.face_count == 0)
+        return;
+
+    // written aside and renamed over, so a reader never maps half a file
+    CacheLayout layout(header.vertex_count, header.face_count, header.meshlet_count);
+    std::string temp_path = cache_path + ".tmp";
+    FILE* f = fopen(temp_path.c_str(), "wb");
+    if (!f)
+        return; // the cache is optional, a read only directory just parses every time
+
+    size_t lanes = this->own_positions.x.size();
+    CacheWriter out{ f };
+    bool ok = out.write_at(0, &header, sizeof(header))
+        && out.write_at(layout.vertices, this->vertices.data, this->vertices.size * sizeof(Vec4))
+        && out.write_at(layout.x, this->own_positions.x.data(), lanes * sizeof(float))
+        && out.write_at(layout.y, this->own_positions.y.data(), lanes * sizeof(float))
+        && out.write_at(layout.z, this->own_positions.z.data(), lanes * sizeof(float))
+        && out.write_at(layout.w, this->own_positions.w.data(), lanes * sizeof(float))
+        && out.write_at(layout.indices, this->indices.data, this->indices.size * sizeof(uint32_t))
+        && out.write_at(layout.normals, this->normals.data, this->normals.size * sizeof(Vec4))
+        && out.write_at(layout.meshlets, this->meshlets.data, this->meshlets.size * sizeof(Meshlet));
+    ok = fclose(f) == 0 && ok;
+
+    remove(cache_path.c_str());
+    if (!ok || rename(temp_path.c_str(), cache_path.c_str()) != 0)
+        remove(temp_path.c_str());
+}
+
+} // trace
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "mesh.hpp"
+
+namespace trace {
+
+/**
+ * Meshlets are grown breadth first over faces that share a vertex, so each
+ * is a compact patch. When a patch runs out of neighbours before it is full,
+ * which disconnected pieces such as the walls of a level do all the time, it
+ * goes on with the next face in Morton order of the face centroids, which is
+ * near by more often than not.
+ */
+
+namespace {
+
+// the low 10 bits of v spread out to every third bit
+uint32_t spread_bits(uint32_t v)
+{
+    v &= 0x3ff;
+    v = (v | v << 16) & 0x030000ff;
+    v = (v | v << 8) & 0x0300f00f;
+    v = (v | v << 4) & 0x030c30c3;
+    v = (v | v << 2) & 0x09249249;
+    return v;
+}
+
+} // namespace
+
+void Mesh::build_meshlets()
+{
+    const std::vector<Vec4>& positions = this->own_vertices;
+    const std::vector<uint32_t>& indices = this->own_indices;
+    uint32_t faces = (uint32_t)(indices.size() / 3);
+
+    Vec4 lo = positions.empty() ? point(0, 0, 0) : positions[0];
+    Vec4 hi = lo;
+    for (const Vec4& v : positions) {
+        lo = point(std::min(lo.x, v.x), std::min(lo.y, v.y), std::min(lo.z, v.z));
+        hi = point(std::max(hi.x, v.x), std::max(hi.y, v.y), std::max(hi.z, v.z));
+    }
+    Vec4 extent = hi - lo;
+    float scale = 1023.0f / std::max(1e-20f, std::max(extent.x, std::max(extent.y, extent.z)));
+
+    std::vector<uint64_t> order(faces);
+    std::vector<uint64_t> scratch;
+    for (uint32_t f = 0; f < faces; f++) {
+        Vec4 c = (positions[indices[f * 3]] + positions[indices[f * 3 + 1]] + positions[indices[f * 3 + 2]]) * (1.0f / 3.0f) - lo;
+        uint32_t code = spread_bits((uint32_t)(c.x * scale)) | spread_bits((uint32_t)(c.y * scale)) << 1 | spread_bits((uint32_t)(c.z * scale)) << 2;
+        order[f] = (uint64_t)code << 32 | f;
+    }
+    radix_sort(order, scratch);
+
+    // faces around each vertex, those of vertex v at around[first[v], first[v + 1])
+    std::vector<uint32_t> first(positions.size() + 1);
+    std::vector<uint32_t> around(indices.size());
+    for (uint32_t v : indices)
+        first[v + 1]++;
+    for (size_t v = 0; v < positions.size(); v++)
+        first[v + 1] += first[v];
+    std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        around[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+    std::vector<Vec4> grouped_vertices;
+    std::vector<uint32_t> grouped_indices;
+    std::vector<uint8_t> taken(faces);
+    std::vector<uint32_t> placed_in(positions.size()); // meshlet + 1 each vertex was last copied to
+    std::vector<uint32_t> placed_at(positions.size()); // and where
+    std::vector<uint32_t> frontier;
+    size_t cursor = 0;
+    this->own_meshlets.clear();
+
+    for (;;) {
+        while (cursor < faces && taken[(uint32_t)order[cursor]])
+            cursor++;
+        if (cursor == faces)
+            break;
+
+        uint32_t id = (uint32_t)this->own_meshlets.size() + 1;
+        Meshlet m = Meshlet{};
+        m.vertex_begin = (uint32_t)grouped_vertices.size();
+        m.face_begin = (uint32_t)(grouped_indices.size() / 3);
+        frontier.clear();
+        size_t head = 0;
+
+        while (m.face_count < MESH_MESHLET_FACES) {
+            uint32_t f;
+            if (head < frontier.size()) {
+                f = frontier[head++];
+                if (taken[f])
+                    continue;
+            }
+            else {
+                while (cursor < faces && taken[(uint32_t)order[cursor]])
+                    cursor++;
+                if (cursor == faces)
+                    break;
+                f = (uint32_t)order[cursor];
+            }
+
+            taken[f] = 1;
+            m.face_count++;
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[f * 3 + k];
+                if (placed_in[v] != id) {
+                    placed_in[v] = id;
+                    placed_at[v] = (uint32_t)grouped_vertices.size();
+                    grouped_vertices.push_back(positions[v]);
+                }
+                grouped_indices.push_back(placed_at[v]);
+                for (uint32_t i = first[v]; i < first[v + 1]; i++) {
+                    if (!taken[around[i]])
+                        frontier.push_back(around[i]);
+                }
+            }
+        }
+
+        // so the kernels can take a meshlet at a time
+        while ((grouped_vertices.size() - m.vertex_begin) % PIPELINE_LANES)
+            grouped_vertices.push_back(grouped_vertices.back());
+        m.vertex_count = (uint32_t)grouped_vertices.size() - m.vertex_begin;
+        this->own_meshlets.push_back(m);
+    }
+
+    this->own_vertices.swap(grouped_vertices);
+    this->own_indices.swap(grouped_indices);
+}
+
+void Mesh::bound_meshlets()
+{
+    for (Meshlet& m : this->own_meshlets) {
+        const Vec4* v = &this->own_vertices[m.vertex_begin];
+        Vec4 lo = v[0], hi = v[0];
+        for (uint32_t i = 1; i < m.vertex_count; i++) {
+            lo = point(std::min(lo.x, v[i].x), std::min(lo.y, v[i].y), std::min(lo.z, v[i].z));
+            hi = point(std::max(hi.x, v[i].x), std::max(hi.y, v[i].y), std::max(hi.z, v[i].z));
+        }
+        m.center = (lo + hi) * 0.5f;
+        m.radius = 0;
+        for (uint32_t i = 0; i < m.vertex_count; i++)
+            m.radius = std::max(m.radius, distance(m.center, v[i]));
+
+        // degenerate faces have no normal and are never drawn, so they do not count
+        const Vec4* n = &this->own_normals[m.face_begin];
+        Vec4 sum = direction(0, 0, 0);
+        for (uint32_t f = 0; f < m.face_count; f++) {
+            if (dot(n[f], n[f]) > 0.5f)
+                sum += n[f];
+        }
+        m.cone_axis = length(sum) > 0 ? normalize(sum) : direction(0, 0, 1);
+        m.cone_cos = length(sum) > 0 ? 1.0f : -1.0f;
+        for (uint32_t f = 0; f < m.face_count; f++) {
+            if (dot(n[f], n[f]) > 0.5f)
+                m.cone_cos = std::min(m.cone_cos, dot(n[f], m.cone_axis));
+        }
+        m.cone_sin = std::sqrt(std::max(0.0f, 1.0f - m.cone_cos * m.cone_cos));
+    }
+}
+
+} // trace
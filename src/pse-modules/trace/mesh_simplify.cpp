@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "mesh.hpp"
+
+namespace trace {
+
+/**
+ * Garland and Heckbert's quadric error simplification. Every vertex sums the
+ * squared distance to the planes of the faces around it as a quadric, and the
+ * edge whose merged quadric has the least error at its best position is
+ * collapsed first. Border edges add a plane through them at right angles to
+ * their face, so open borders such as a terrain's keep their outline.
+ *
+ * The quadric cost weighs border planes up and sums squares, so it is no
+ * length. The error the mesh reports is instead the furthest any collapsed
+ * position ends up from the planes, face or border, of the source faces it
+ * stands in for, which select_lod can project to pixels.
+ */
+
+// how much more a border plane counts than a face plane
+#define SIMPLIFY_BORDER_WEIGHT 10.0
+
+namespace {
+
+// symmetric 4x4 matrix, in doubles as sums of many planes cancel badly in floats
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0;
+    double yy = 0, yz = 0, yw = 0;
+    double zz = 0, zw = 0;
+    double ww = 0;
+
+    // squared distance to the plane through p with unit normal n, times weight
+    static Quadric plane(const Vec4& n, const Vec4& p, double weight) {
+        double a = n.x, b = n.y, c = n.z, d = -dot(n, p);
+        Quadric q;
+        q.xx = a * a * weight; q.xy = a * b * weight; q.xz = a * c * weight; q.xw = a * d * weight;
+        q.yy = b * b * weight; q.yz = b * c * weight; q.yw = b * d * weight;
+        q.zz = c * c * weight; q.zw = c * d * weight;
+        q.ww = d * d * weight;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& q) {
+        xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw;
+        yy += q.yy; yz += q.yz; yw += q.yw;
+        zz += q.zz; zw += q.zw;
+        ww += q.ww;
+        return *this;
+    }
+
+    double error(const Vec4& v) const {
+        double x = v.x, y = v.y, z = v.z;
+        double e = xx * x * x + yy * y * y + zz * z * z + ww
+            + 2 * (xy * x * y + xz * x * z + yz * y * z + xw * x + yw * y + zw * z);
+        return std::max(0.0, e);
+    }
+
+    // the position of least error, false when the planes do not pin down a point
+    bool minimum(Vec4& out) const {
+        double c00 = yy * zz - yz * yz;
+        double c01 = xz * yz - xy * zz;
+        double c02 = xy * yz - xz * yy;
+        double det = xx * c00 + xy * c01 + xz * c02;
+        double scale = xx + yy + zz;
+        if (std::abs(det) <= 1e-9 * scale * scale * scale)
+            return false;
+        double c11 = xx * zz - xz * xz;
+        double c12 = xy * xz - xx * yz;
+        double c22 = xx * yy - xy * xy;
+        double inv = -1.0 / det;
+        out = point(
+            (float)((c00 * xw + c01 * yw + c02 * zw) * inv),
+            (float)((c01 * xw + c11 * yw + c12 * zw) * inv),
+            (float)((c02 * xw + c12 * yw + c22 * zw) * inv));
+        return true;
+    }
+};
+
+struct Collapse {
+    double cost;
+    uint32_t keep;
+    uint32_t remove;
+    uint32_t keep_stamp; // the stamps of both when queued, see Simplifier::stamps
+    uint32_t remove_stamp;
+    Vec4 position;
+
+    // the queue pops the cheapest first
+    bool operator<(const Collapse& c) const {
+        return this->cost > c.cost;
+    }
+};
+
+struct Simplifier {
+    std::vector<Vec4> positions;
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> stamps; // bumped when a vertex changes, older collapses of it are stale
+    std::vector<uint8_t> vertex_alive;
+    std::vector<uint32_t> faces; // 3 per face
+    std::vector<uint8_t> face_alive;
+    std::vector<std::vector<uint32_t>> vertex_faces; // faces around each vertex, may list dead ones
+    std::vector<Vec4> planes; // of the source, unit normal and w = -dot(normal, point on it)
+    std::vector<std::vector<uint32_t>> vertex_planes; // those each vertex stands in for, sorted
+    std::priority_queue<Collapse> queue;
+    size_t face_count = 0;
+    double max_distance = 0;
+
+    void add_plane(const Vec4& n, const Vec4& p, uint32_t a, uint32_t b, uint32_t c) {
+        uint32_t id = (uint32_t)this->planes.size();
+        this->planes.push_back(Vec4{ n.x, n.y, n.z, -dot(n, p) });
+        for (uint32_t v : { a, b, c }) {
+            std::vector<uint32_t>& list = this->vertex_planes[v];
+            if (list.empty() || list.back() != id)
+                list.push_back(id);
+        }
+    }
+
+    Vec4 face_normal(uint32_t f, uint32_t moved, const Vec4& to) const {
+        Vec4 p[3];
+        for (int k = 0; k < 3; k++)
+            p[k] = this->faces[f * 3 + k] == moved ? to : this->positions[this->faces[f * 3 + k]];
+        return cross(p[1] - p[0], p[2] - p[0]);
+    }
+
+    void push(uint32_t keep, uint32_t remove) {
+        Quadric q = this->quadrics[keep];
+        q += this->quadrics[remove];
+
+        // the best point, or the best of the ends and the middle of the edge when
+        // there is none or it is far off, as near parallel planes can put it
+        const Vec4& a = this->positions[keep];
+        const Vec4& b = this->positions[remove];
+        Collapse c;
+        if (!q.minimum(c.position) || distance(c.position, (a + b) * 0.5f) > distance(a, b)) {
+            Vec4 candidates[3] = { a, b, (a + b) * 0.5f };
+            c.position = a;
+            for (const Vec4& candidate : candidates) {
+                if (q.error(candidate) < q.error(c.position))
+                    c.position = candidate;
+            }
+        }
+        c.cost = q.error(c.position);
+        c.keep = keep;
+        c.remove = remove;
+        c.keep_stamp = this->stamps[keep];
+        c.remove_stamp = this->stamps[remove];
+        this->queue.push(c);
+    }
+
+    // would moving v to position turn any of its faces, other than those it
+    // shares with other, over or down to nothing
+    bool folds(uint32_t v, uint32_t other, const Vec4& position) const {
+        for (uint32_t f : this->vertex_faces[v]) {
+            if (!this->face_alive[f])
+                continue;
+            const uint32_t* face = &this->faces[f * 3];
+            if (face[0] == other || face[1] == other || face[2] == other)
+                continue;
+            if (dot(this->face_normal(f, v, position), this->face_normal(f, v, this->positions[v])) <= 0)
+                return true;
+        }
+        return false;
+    }
+
+    void collapse(const Collapse& c) {
+        this->positions[c.keep] = c.position;
+        this->quadrics[c.keep] += this->quadrics[c.remove];
+        this->vertex_alive[c.remove] = 0;
+        this->stamps[c.keep]++;
+
+        std::vector<uint32_t>& planes = this->vertex_planes[c.keep];
+        std::vector<uint32_t> merged;
+        std::set_union(planes.begin(), planes.end(), this->vertex_planes[c.remove].begin(), this->vertex_planes[c.remove].end(), std::back_inserter(merged));
+        planes.swap(merged);
+        this->vertex_planes[c.remove].clear();
+        for (uint32_t i : planes) {
+            const Vec4& plane = this->planes[i];
+            this->max_distance = std::max(this->max_distance, (double)std::abs(dot(plane, c.position) + plane.w));
+        }
+
+        // faces on the edge go, the rest of those around remove move to keep
+        std::vector<uint32_t>& around = this->vertex_faces[c.keep];
+        for (uint32_t f : this->vertex_faces[c.remove]) {
+            if (!this->face_alive[f])
+                continue;
+            uint32_t* face = &this->faces[f * 3];
+            if (face[0] == c.keep || face[1] == c.keep || face[2] == c.keep) {
+                this->face_alive[f] = 0;
+                this->face_count--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (face[k] == c.remove)
+                    face[k] = c.keep;
+            }
+            around.push_back(f);
+        }
+        this->vertex_faces[c.remove].clear();
+        around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t f) { return !this->face_alive[f]; }), around.end());
+
+        // every edge from keep has a new cost
+        std::vector<uint32_t> neighbours;
+        for (uint32_t f : around) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t n = this->faces[f * 3 + k];
+                if (n != c.keep && std::find(neighbours.begin(), neighbours.end(), n) == neighbours.end())
+                    neighbours.push_back(n);
+            }
+        }
+        for (uint32_t n : neighbours)
+            this->push(c.keep, n);
+    }
+};
+
+inline uint64_t edge_key(uint32_t a, uint32_t b)
+{
+    return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+} // namespace
+
+void Mesh::simplify(const Mesh& source, size_t face_count)
+{
+    Simplifier s;
+
+    // meshlets repeat the positions they share, weld them back together so
+    // their edges are not taken for borders
+    std::vector<uint32_t> order(source.vertices.size);
+    std::vector<uint32_t> weld(source.vertices.size);
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (uint32_t)i;
+    auto less = [&](uint32_t a, uint32_t b) {
+        const Vec4& p = source.vertices[a];
+        const Vec4& q = source.vertices[b];
+        return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+    };
+    std::sort(order.begin(), order.end(), less);
+    for (size_t i = 0; i < order.size(); i++) {
+        if (i == 0 || less(order[i - 1], order[i]))
+            s.positions.push_back(source.vertices[order[i]]);
+        weld[order[i]] = (uint32_t)s.positions.size() - 1;
+    }
+    for (uint32_t v : source.indices)
+        s.faces.push_back(weld[v]);
+
+    s.face_count = source.face_count();
+    s.quadrics.resize(s.positions.size());
+    s.stamps.resize(s.positions.size());
+    s.vertex_alive.assign(s.positions.size(), 1);
+    s.face_alive.assign(s.face_count, 1);
+    s.vertex_faces.resize(s.positions.size());
+    s.vertex_planes.resize(s.positions.size());
+
+    // edges used by one face only are borders
+    std::unordered_map<uint64_t, uint32_t> edge_faces;
+    for (size_t i = 0; i < s.faces.size(); i++)
+        edge_faces[edge_key(s.faces[i], s.faces[i - i % 3 + (i + 1) % 3])]++;
+
+    for (uint32_t f = 0; f < s.face_count; f++) {
+        const uint32_t* face = &s.faces[f * 3];
+        Vec4 normal = cross(s.positions[face[1]] - s.positions[face[0]], s.positions[face[2]] - s.positions[face[0]]);
+        for (int k = 0; k < 3; k++)
+            s.vertex_faces[face[k]].push_back(f);
+        if (length(normal) == 0)
+            continue;
+        normal = normalize(normal);
+        Quadric q = Quadric::plane(normal, s.positions[face[0]], 1.0);
+        s.add_plane(normal, s.positions[face[0]], face[0], face[1], face[2]);
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = face[k], b = face[(k + 1) % 3];
+            s.quadrics[a] += q;
+            if (edge_faces[edge_key(a, b)] != 1)
+                continue;
+            Vec4 side = cross(s.positions[b] - s.positions[a], normal);
+            if (length(side) == 0)
+                continue;
+            Quadric border = Quadric::plane(normalize(side), s.positions[a], SIMPLIFY_BORDER_WEIGHT);
+            s.quadrics[a] += border;
+            s.quadrics[b] += border;
+            s.add_plane(normalize(side), s.positions[a], a, b, b);
+        }
+    }
+
+    // queue every edge once, in face order so the result is always the same
+    std::unordered_set<uint64_t> queued;
+    for (size_t i = 0; i < s.faces.size(); i++) {
+        uint32_t a = s.faces[i], b = s.faces[i - i % 3 + (i + 1) % 3];
+        if (a != b && queued.insert(edge_key(a, b)).second)
+            s.push(std::min(a, b), std::max(a, b));
+    }
+
+    while (s.face_count > face_count && !s.queue.empty()) {
+        Collapse c = s.queue.top();
+        s.queue.pop();
+        if (!s.vertex_alive[c.keep] || !s.vertex_alive[c.remove]
+            || s.stamps[c.keep] != c.keep_stamp || s.stamps[c.remove] != c.remove_stamp)
+            continue;
+        // dropped for now, it is queued again if either end changes
+        if (s.folds(c.keep, c.remove, c.position) || s.folds(c.remove, c.keep, c.position))
+            continue;
+        s.collapse(c);
+    }
+
+    // keep what is left, in the order it came in, without vertices no face uses
+    std::vector<uint8_t> used(s.positions.size());
+    for (size_t f = 0; f < s.face_alive.size(); f++) {
+        for (int k = 0; s.face_alive[f] && k < 3; k++)
+            used[s.faces[f * 3 + k]] = 1;
+    }
+    std::vector<uint32_t> remap(s.positions.size());
+    this->own_vertices.clear();
+    for (size_t v = 0; v < s.positions.size(); v++) {
+        if (!used[v])
+            continue;
+        remap[v] = (uint32_t)this->own_vertices.size();
+        this->own_vertices.push_back(s.positions[v]);
+    }
+    this->own_indices.clear();
+    for (size_t f = 0; f < s.face_alive.size(); f++) {
+        if (!s.face_alive[f])
+            continue;
+        for (int k = 0; k < 3; k++)
+            this->own_indices.push_back(remap[s.faces[f * 3 + k]]);
+    }
+
+    this->error = source.error + (float)s.max_distance;
+    this->build();
+}
+
+} // trace
@@ -0,0 +1,236 @@
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+
+#include "pipeline.hpp"
+
+namespace trace {
+
+void Stream::resize(size_t n)
+{
+    size_t padded = (n + PIPELINE_LANES - 1) / PIPELINE_LANES * PIPELINE_LANES;
+    this->x.resize(padded);
+    this->y.resize(padded);
+    this->z.resize(padded);
+    this->w.resize(padded);
+    this->size = n;
+}
+
+StreamView Stream::view() const
+{
+    return StreamView{ this->x.data(), this->y.data(), this->z.data(), this->w.data(), this->size };
+}
+
+#if defined(__AVX__)
+static inline __m256 madd(__m256 a, __m256 b, __m256 c)
+{
+#if defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+#endif
+
+void transform_project(const Mat4& m, const StreamView& in, size_t begin, size_t end,
+    Stream& clip, Stream& screen, std::vector<uint8_t>& codes, float width, float height, float guard)
+{
+    const float half_w = 0.5f * width;
+    const float half_h = 0.5f * height;
+    size_t i = begin;
+
+#if defined(__AVX__)
+    __m256 m00 = _mm256_set1_ps(m[0].x), m01 = _mm256_set1_ps(m[0].y), m02 = _mm256_set1_ps(m[0].z), m03 = _mm256_set1_ps(m[0].w);
+    __m256 m10 = _mm256_set1_ps(m[1].x), m11 = _mm256_set1_ps(m[1].y), m12 = _mm256_set1_ps(m[1].z), m13 = _mm256_set1_ps(m[1].w);
+    __m256 m20 = _mm256_set1_ps(m[2].x), m21 = _mm256_set1_ps(m[2].y), m22 = _mm256_set1_ps(m[2].z), m23 = _mm256_set1_ps(m[2].w);
+    __m256 m30 = _mm256_set1_ps(m[3].x), m31 = _mm256_set1_ps(m[3].y), m32 = _mm256_set1_ps(m[3].z), m33 = _mm256_set1_ps(m[3].w);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 scale_x = _mm256_set1_ps(half_w);
+    __m256 scale_y = _mm256_set1_ps(half_h);
+
+    for (; i < end; i += PIPELINE_LANES) {
+        __m256 x = _mm256_loadu_ps(&in.x[i]);
+        __m256 y = _mm256_loadu_ps(&in.y[i]);
+        __m256 z = _mm256_loadu_ps(&in.z[i]);
+
+        __m256 cx = madd(x, m00, madd(y, m10, madd(z, m20, m30)));
+        __m256 cy = madd(x, m01, madd(y, m11, madd(z, m21, m31)));
+        __m256 cz = madd(x, m02, madd(y, m12, madd(z, m22, m32)));
+        __m256 cw = madd(x, m03, madd(y, m13, madd(z, m23, m33)));
+        _mm256_storeu_ps(&clip.x[i], cx);
+        _mm256_storeu_ps(&clip.y[i], cy);
+        _mm256_storeu_ps(&clip.z[i], cz);
+        _mm256_storeu_ps(&clip.w[i], cw);
+
+        __m256 rw = _mm256_div_ps(one, cw);
+        _mm256_storeu_ps(&screen.x[i], _mm256_mul_ps(madd(cx, rw, one), scale_x));
+        _mm256_storeu_ps(&screen.y[i], _mm256_mul_ps(madd(cy, rw, one), scale_y));
+        _mm256_storeu_ps(&screen.z[i], _mm256_mul_ps(cz, rw));
+        _mm256_storeu_ps(&screen.w[i], rw);
+
+        // one bit mask of 8 vertices per plane, then transposed to a code per vertex
+        __m256 ncw = _mm256_sub_ps(_mm256_setzero_ps(), cw);
+        __m256 gw = _mm256_mul_ps(cw, _mm256_set1_ps(guard));
+        __m256 ngw = _mm256_sub_ps(_mm256_setzero_ps(), gw);
+        int outside[8] = {
+            _mm256_movemask_ps(_mm256_cmp_ps(cx, ncw, _CMP_LT_OQ)),
+            _mm256_movemask_ps(_mm256_cmp_ps(cx, cw, _CMP_GT_OQ)),
+            _mm256_movemask_ps(_mm256_cmp_ps(cy, ncw, _CMP_LT_OQ)),
+            _mm256_movemask_ps(_mm256_cmp_ps(cy, cw, _CMP_GT_OQ)),
+            _mm256_movemask_ps(_mm256_cmp_ps(cz, _mm256_setzero_ps(), _CMP_LT_OQ)),
+            _mm256_movemask_ps(_mm256_cmp_ps(cz, cw, _CMP_GT_OQ)),
+            _mm256_movemask_ps(_mm256_or_ps(_mm256_cmp_ps(cx, gw, _CMP_GT_OQ), _mm256_cmp_ps(cx, ngw, _CMP_LT_OQ))),
+            _mm256_movemask_ps(_mm256_or_ps(_mm256_cmp_ps(cy, gw, _CMP_GT_OQ), _mm256_cmp_ps(cy, ngw, _CMP_LT_OQ))),
+        };
+        size_t lanes = end - i < PIPELINE_LANES ? end - i : PIPELINE_LANES;
+        for (size_t k = 0; k < lanes; k++) {
+            uint8_t code = 0;
+            for (int p = 0; p < 8; p++)
+                code |= ((outside[p] >> k) & 1) << p;
+            codes[i + k] = code;
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        Vec4 c = point(in.x[i], in.y[i], in.z[i]) * m;
+        clip.x[i] = c.x;
+        clip.y[i] = c.y;
+        clip.z[i] = c.z;
+        clip.w[i] = c.w;
+
+        float rw = 1.0f / c.w;
+        screen.x[i] = (c.x * rw + 1.0f) * half_w;
+        screen.y[i] = (c.y * rw + 1.0f) * half_h;
+        screen.z[i] = c.z * rw;
+        screen.w[i] = rw;
+        codes[i] = outcode(c, guard);
+    }
+}
+
+// signed distance to a ClipPlane by bit index, inside is positive
+static inline float plane_distance(const Vec4& v, int plane)
+{
+    switch (plane) {
+    case 0: return v.w + v.x;
+    case 1: return v.w - v.x;
+    case 2: return v.w + v.y;
+    case 3: return v.w - v.y;
+    case 4: return v.z;
+    default: return v.w - v.z;
+    }
+}
+
+int clip_polygon(Vec4 poly[CLIP_MAX_VERTICES], int count, unsigned planes)
+{
+    Vec4 scratch[CLIP_MAX_VERTICES];
+    Vec4 *in = poly;
+    Vec4 *out = scratch;
+
+    for (int p = 0; p < CLIP_PLANES && count > 0; p++) {
+        if (!(planes & (1u << p)))
+            continue;
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            const Vec4& a = in[i];
+            const Vec4& b = in[(i + 1) % count];
+            float da = plane_distance(a, p);
+            float db = plane_distance(b, p);
+            if (da >= 0)
+                out[n++] = a;
+            if ((da >= 0) != (db >= 0))
+                out[n++] = a + (b - a) * (da / (da - db));
+        }
+        count = n;
+        std::swap(in, out);
+    }
+
+    if (in != poly)
+        std::copy(in, in + count, poly);
+    return count;
+}
+
+void frustum_planes(const Mat4& m, Vec4 planes[CLIP_PLANES])
+{
+    // clip space x is dot of the position with the first column and so on
+    Vec4 column[4];
+    for (int j = 0; j < 4; j++)
+        column[j] = Vec4{ m[0][j], m[1][j], m[2][j], m[3][j] };
+    planes[0] = column[3] + column[0]; // x >= -w
+    planes[1] = column[3] - column[0]; // x <= w
+    planes[2] = column[3] + column[1]; // y >= -w
+    planes[3] = column[3] - column[1]; // y <= w
+    planes[4] = column[2];             // z >= 0
+    planes[5] = column[3] - column[2]; // z <= w
+    for (int i = 0; i < CLIP_PLANES; i++)
+        planes[i] = planes[i] / length(planes[i]);
+}
+
+void radix_sort(std::vector<uint64_t>& pairs, std::vector<uint64_t>& scratch)
+{
+    size_t n = pairs.size();
+    scratch.resize(n);
+    if (n < 2)
+        return;
+
+    // every histogram in one read of the keys
+    size_t counts[4][256] = {{0}};
+    for (uint64_t pair : pairs) {
+        uint32_t key = (uint32_t)(pair >> 32);
+        for (int b = 0; b < 4; b++)
+            counts[b][(key >> (b * 8)) & 0xff]++;
+    }
+
+    for (int b = 0; b < 4; b++) {
+        int shift = 32 + b * 8;
+        if (counts[b][(pairs[0] >> shift) & 0xff] == n)
+            continue;
+
+        size_t offsets[256];
+        size_t sum = 0;
+        for (int i = 0; i < 256; i++) {
+            offsets[i] = sum;
+            sum += counts[b][i];
+        }
+        for (uint64_t pair : pairs)
+            scratch[offsets[(pair >> shift) & 0xff]++] = pair;
+        pairs.swap(scratch);
+    }
+}
+
+void cull_backfaces(const Stream& planes, const Vec4& camera, size_t begin, size_t end, std::vector<uint32_t>& visible)
+{
+    visible.resize(end - begin);
+    size_t count = 0;
+    size_t i = begin;
+
+#if defined(__AVX__)
+    __m256 cx = _mm256_set1_ps(camera.x);
+    __m256 cy = _mm256_set1_ps(camera.y);
+    __m256 cz = _mm256_set1_ps(camera.z);
+
+    for (; i + PIPELINE_LANES <= end; i += PIPELINE_LANES) {
+        __m256 side = _mm256_sub_ps(
+            madd(_mm256_loadu_ps(&planes.x[i]), cx,
+            madd(_mm256_loadu_ps(&planes.y[i]), cy,
+            _mm256_mul_ps(_mm256_loadu_ps(&planes.z[i]), cz))),
+            _mm256_loadu_ps(&planes.w[i]));
+        unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(side, _mm256_setzero_ps(), _CMP_GT_OQ));
+        // branchless compaction, a rejected index is overwritten by the next
+        for (int k = 0; k < PIPELINE_LANES; k++) {
+            visible[count] = (uint32_t)(i + k);
+            count += (mask >> k) & 1;
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        if (planes.x[i] * camera.x + planes.y[i] * camera.y + planes.z[i] * camera.z - planes.w[i] > 0)
+            visible[count++] = (uint32_t)i;
+    }
+    visible.resize(count);
+}
+
+} // trace
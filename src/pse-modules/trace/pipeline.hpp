@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "types.hpp"
+
+namespace trace {
+
+// vertices processed per step by the kernels, streams are padded to it
+#define PIPELINE_LANES 8
+
+// read only stream over arrays owned elsewhere, padded the same way as Stream
+struct StreamView {
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* z = nullptr;
+    const float* w = nullptr;
+    size_t size = 0;
+};
+
+/**
+ * Structure of arrays vertex stream. Every array holds the same number of
+ * floats, rounded up to PIPELINE_LANES so kernels never need a remainder loop.
+ */
+struct Stream {
+    std::vector<float> x, y, z, w;
+    size_t size = 0; // vertices in use, the padding past it is garbage
+
+    void resize(size_t n);
+    StreamView view() const;
+};
+
+// frustum planes in clip space, a vertex outside a plane has its bit set in its outcode
+enum ClipPlane {
+    CLIP_X_MIN = 0x01, // x < -w
+    CLIP_X_MAX = 0x02, // x > w
+    CLIP_Y_MIN = 0x04, // y < -w
+    CLIP_Y_MAX = 0x08, // y > w
+    CLIP_NEAR  = 0x10, // z < 0
+    CLIP_FAR   = 0x20, // z > w
+    CLIP_GUARD_X = 0x40, // |x| > guard * w, past the guard band on either side
+    CLIP_GUARD_Y = 0x80, // |y| > guard * w
+};
+
+// the bits of the actual frustum planes, the guard bits are not planes
+#define CLIP_FRUSTUM 0x3f
+#define CLIP_PLANES 6
+// every plane adds at most one vertex to a convex polygon
+#define CLIP_MAX_VERTICES (3 + CLIP_PLANES)
+
+/**
+ * Multiply positions [begin, end) (w = 1) of in by m into clip space, then
+ * divide by w and map to a width x height viewport into screen, where z is the
+ * depth, and write the ClipPlane outcode of each to codes, with the guard
+ * band guard times the viewport. Screen values are only meaningful where
+ * CLIP_NEAR is not set. clip, screen and codes must already be sized to in,
+ * and begin and end be multiples of PIPELINE_LANES unless end is in.size, so
+ * threads can split the streams.
+ */
+void transform_project(const Mat4& m, const StreamView& in, size_t begin, size_t end,
+    Stream& clip, Stream& screen, std::vector<uint8_t>& codes, float width, float height, float guard);
+
+/**
+ * Sutherland-Hodgman clip the convex clip space polygon of count vertices in
+ * poly against every plane set in planes, in place. Returns the vertex count
+ * left, 0 when nothing is inside.
+ */
+int clip_polygon(Vec4 poly[CLIP_MAX_VERTICES], int count, unsigned planes);
+
+/**
+ * Stable LSD radix sort of key << 32 | index pairs by their key, a byte per
+ * pass, skipping passes where every key has the same byte. Linear in the
+ * pair count, and the pairs are small compared to what they index. scratch
+ * is resized to fit and may end up swapped with pairs.
+ */
+void radix_sort(std::vector<uint64_t>& pairs, std::vector<uint64_t>& scratch);
+
+/**
+ * Fill visible with the index of every face in [begin, end) whose plane,
+ * normal in x, y, z and distance from the origin along it in w, has the
+ * camera on its front side.
+ */
+void cull_backfaces(const Stream& planes, const Vec4& camera, size_t begin, size_t end, std::vector<uint32_t>& visible);
+
+/**
+ * The frustum of clip space pulled back through m into the space it maps
+ * from, one plane per ClipPlane bit in order. Normals are unit length and
+ * point inwards, so a point p is inside a plane where dot(plane, p) + plane.w
+ * is not negative, and that is its distance to it.
+ */
+void frustum_planes(const Mat4& m, Vec4 planes[CLIP_PLANES]);
+
+// unsigned key that orders the same as the float it is made from
+inline uint32_t float_key(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+// the scalar version of the outcode for a single clip space vertex
+inline uint8_t outcode(const Vec4& clip, float guard)
+{
+    return (clip.x < -clip.w ? CLIP_X_MIN : 0) | (clip.x > clip.w ? CLIP_X_MAX : 0)
+         | (clip.y < -clip.w ? CLIP_Y_MIN : 0) | (clip.y > clip.w ? CLIP_Y_MAX : 0)
+         | (clip.z < 0 ? CLIP_NEAR : 0) | (clip.z > clip.w ? CLIP_FAR : 0)
+         | (std::abs(clip.x) > guard * clip.w ? CLIP_GUARD_X : 0)
+         | (std::abs(clip.y) > guard * clip.w ? CLIP_GUARD_Y : 0);
+}
+
+// the scalar version for a single clip space vertex, w must be positive and
+// becomes 1 / w as in the screen stream
+inline Vec4 viewport(const Vec4& clip, float width, float height)
+{
+    float rw = 1.0f / clip.w;
+    return Vec4{ (clip.x * rw + 1.0f) * 0.5f * width, (clip.y * rw + 1.0f) * 0.5f * height, clip.z * rw, rw };
+}
+
+} // trace
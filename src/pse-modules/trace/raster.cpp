@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cmath>
+
+#include "raster.hpp"
+
+namespace trace {
+
+// bias letting lines through that are this fraction behind the depth buffer,
+// so edges are not hidden by the faces they belong to
+#define LINE_DEPTH_BIAS (1.0f / 256.0f)
+
+void Framebuffer::resize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    this->color.resize((size_t)width * height);
+    this->depth.resize((size_t)width * height);
+}
+
+void Framebuffer::clear(uint32_t argb, int y0, int y1)
+{
+    size_t begin = (size_t)y0 * this->width;
+    size_t end = (size_t)y1 * this->width;
+    std::fill(this->color.begin() + begin, this->color.begin() + end, argb);
+    std::fill(this->depth.begin() + begin, this->depth.begin() + end, 0.0f);
+}
+
+void Framebuffer::fill(const Triangle& t, uint32_t argb, bool write_color, int y0, int y1, std::vector<SDL_Rect>& spans)
+{
+    // snap to the 28.4 grid the 2D rasterizers use, so coverage follows the
+    // same top-left rule and shared edges neither crack nor draw twice
+    int x[3], y[3];
+    for (int k = 0; k < 3; k++) {
+        x[k] = (int)lroundf(t.p[k].x * PSE_SUBPIXEL_ONE);
+        y[k] = (int)lroundf(t.p[k].y * PSE_SUBPIXEL_ONE);
+    }
+    int64_t area = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) - (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0)
+        return;
+
+    // 1 / w is linear in screen space, a plane through the snapped vertices
+    double scale = (double)PSE_SUBPIXEL_ONE / area;
+    double dz1 = t.p[1].w - t.p[0].w, dz2 = t.p[2].w - t.p[0].w;
+    double dz_dx = (dz1 * (y[2] - y[0]) - dz2 * (y[1] - y[0])) * scale;
+    double dz_dy = (dz2 * (x[1] - x[0]) - dz1 * (x[2] - x[0])) * scale;
+    double origin_x = (double)x[0] / PSE_SUBPIXEL_ONE;
+    double origin_y = (double)y[0] / PSE_SUBPIXEL_ONE;
+
+    spans.clear();
+    pse::raster_spans(x[0], y[0], x[1], y[1], x[2], y[2], this->width, y1, spans, y0);
+    for (const SDL_Rect& s : spans) {
+        uint32_t *color_row = &this->color[(size_t)s.y * this->width];
+        float *depth_row = &this->depth[(size_t)s.y * this->width];
+        float z = (float)(t.p[0].w + (s.x + 0.5 - origin_x) * dz_dx + (s.y + 0.5 - origin_y) * dz_dy);
+        float step = (float)dz_dx;
+        for (int px = s.x; px < s.x + s.w; px++) {
+            if (z > depth_row[px]) {
+                depth_row[px] = z;
+                if (write_color)
+                    color_row[px] = argb;
+            }
+            z += step;
+        }
+    }
+}
+
+void Framebuffer::line(const Vec4& a, const Vec4& b, uint32_t argb, int y0, int y1)
+{
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    int steps = (int)std::ceil(std::max(std::abs(dx), std::abs(dy)));
+    if (steps == 0)
+        steps = 1;
+    float inv = 1.0f / steps;
+
+    // only walk the steps that can land in this band of rows
+    int first = 0, last = steps;
+    if (dy != 0) {
+        float t0 = (y0 - 1 - a.y) / dy * steps;
+        float t1 = (y1 + 1 - a.y) / dy * steps;
+        first = std::max(first, (int)std::floor(std::min(t0, t1)));
+        last = std::min(last, (int)std::ceil(std::max(t0, t1)));
+    }
+    else if (a.y < y0 - 1 || a.y > y1 + 1) {
+        return;
+    }
+
+    for (int i = first; i <= last; i++) {
+        float t = i * inv;
+        int x = (int)std::floor(a.x + dx * t);
+        int y = (int)std::floor(a.y + dy * t);
+        if (x < 0 || x >= this->width || y < y0 || y >= y1)
+            continue;
+        size_t at = (size_t)y * this->width + x;
+        float z = a.w + (b.w - a.w) * t;
+        if (z * (1.0f + LINE_DEPTH_BIAS) >= this->depth[at])
+            this->color[at] = argb;
+    }
+}
+
+} // trace
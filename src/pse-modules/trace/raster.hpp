@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+namespace trace {
+
+/**
+ * CPU color and depth buffer the depth tested modes draw into. Depth is the
+ * interpolated 1 / w of the screen stream, larger is nearer and 0 is empty,
+ * which keeps precision even far from the near plane. Every call takes a
+ * band of rows [y0, y1) and only touches those, so threads can each own a
+ * band and draw every triangle into it.
+ */
+struct Framebuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> color; // ARGB8888
+    std::vector<float> depth;
+
+    void resize(int width, int height);
+    void clear(uint32_t argb, int y0, int y1);
+
+    // filled triangle, vertices in screen space with 1 / w in w; depth only without
+    // color. Covers the pixels pse::raster_spans does, spans is its scratch per thread
+    void fill(const Triangle& t, uint32_t argb, bool write_color, int y0, int y1, std::vector<SDL_Rect>& spans);
+
+    // line from a to b drawn where it is not behind what is in the depth buffer
+    void line(const Vec4& a, const Vec4& b, uint32_t argb, int y0, int y1);
+};
+
+} // trace
@@ -0,0 +1,381 @@
+#include <cassert>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../modules.hpp"
+#include "mesh.hpp"
+#include "pipeline.hpp"
+#include "raster.hpp"
+#include "types.hpp"
+#include "workers.hpp"
+
+namespace trace {
+
+pse::Context *Ctx;
+
+// screen sizes past which edges are clipped, G switches between it and 1,
+// which clips exactly to the screen
+#define TRACE_GUARD_BAND 4.0f
+
+// how the clipped triangles end up on screen
+enum RasterMode {
+    RASTER_WIREFRAME, // depth tested edges, hidden lines removed, in the CPU framebuffer
+    RASTER_SOLID,     // depth tested shaded faces in the CPU framebuffer
+    RASTER_PAINTER,   // shaded faces sorted back to front, drawn through the context
+    RASTER_MODES,
+};
+
+struct Graphics {
+    std::vector<Triangle> triangles_to_raster = std::vector<Triangle>{};
+    Stream clip = Stream{};   // mesh vertices in clip space this frame
+    Stream screen = Stream{}; // and in screen space where in front of the camera
+    std::vector<uint8_t> codes = std::vector<uint8_t>{}; // and their ClipPlane outcodes
+    Stream planes = Stream{}; // world space plane of each face, see set_world
+    std::vector<SDL_Color> shades = std::vector<SDL_Color>{}; // per face, see set_light
+    Workers workers;
+    std::vector<std::vector<uint32_t>> visible;         // per thread, faces facing the camera this frame
+    std::vector<std::vector<Triangle>> thread_triangles; // per thread, clipped screen space triangles
+    std::vector<std::vector<uint32_t>> band_triangles;   // per thread, those reaching into its band of rows
+    std::vector<std::vector<SDL_Rect>> thread_spans;     // per thread, scratch of Framebuffer::fill
+    std::vector<uint32_t> meshlets_visible; // meshlets not culled this frame
+    std::vector<std::unique_ptr<Mesh>> lods; // the loaded mesh, then simplified to each of lod_ratios
+    std::vector<float> lod_ratios = { 0.5f, 0.25f, 0.125f }; // of the faces of the loaded mesh
+    float lod_pixels = 1.0f;     // simplification error allowed on screen
+    float lod_hysteresis = 0.5f; // part of lod_pixels a coarser level must be under to switch to it
+    size_t lod = 0;
+    const Mesh* mesh = nullptr; // lods[lod]
+    Mat4 proj_matrix;
+    Mat4 world_matrix;
+    Vec4 camera = point(0.0f, 0.0f, 0.0f);
+    Vec4 look_dir = direction(0.0f, 0.0f, 1.0f);
+    Vec4 up_vec = direction(0.0f, -1.0f, 0.0f);
+    Vec4 light = direction(1.0f, 1.0f, -1.0f);
+    float yaw = 0.0f;
+    float speed = 10.0f;
+    float near = 0.1f;
+    float far = 1000.0f;
+    float fov = 90.0f;
+    float guard_band = TRACE_GUARD_BAND;
+    RasterMode mode = RASTER_WIREFRAME;
+    Framebuffer framebuffer;
+    std::vector<uint64_t> sort_pairs;   // depth key and triangle index, see raster
+    std::vector<uint64_t> sort_scratch;
+    float aspect_ratio;
+    int screen_height;
+    int screen_width;
+    
+    Graphics(const char *path, int screen_height, int screen_width) {
+        this->lods.push_back(std::make_unique<Mesh>());
+        this->lods[0]->load(path, this->workers);
+        for (float ratio : this->lod_ratios) {
+            this->lods.push_back(std::make_unique<Mesh>());
+            this->lods.back()->load_simplified(path, (int)this->lods.size() - 1, *this->lods[this->lods.size() - 2], (size_t)(this->lods[0]->face_count() * ratio));
+        }
+        this->mesh = this->lods[0].get();
+        this->aspect_ratio = (float)screen_height / (float)screen_width;
+        this->screen_height = screen_height;
+        this->screen_width = screen_width;
+        this->proj_matrix = Mat4::project(this->fov, this->aspect_ratio, this->near, this->far);
+        this->visible.resize(this->workers.size());
+        this->thread_triangles.resize(this->workers.size());
+        this->band_triangles.resize(this->workers.size());
+        this->thread_spans.resize(this->workers.size());
+        this->framebuffer.resize(screen_width, screen_height);
+
+        // transform world by rotation, then by translation
+        this->set_world(Mat4::rotate_z(0.0f) * Mat4::rotate_x(0.0f) * Mat4::translate(0.0f, 0.0f, 5.0f));
+    }
+
+    // world must only rotate and translate, normals are moved with it as is
+    void set_world(const Mat4& world) {
+        this->world_matrix = world;
+        this->planes.resize(this->mesh->face_count());
+        for (size_t f = 0; f < this->mesh->face_count(); f++) {
+            Vec4 normal = this->mesh->normals[f] * world;
+            Vec4 p0 = this->mesh->vertices[this->mesh->indices[f * 3]] * world;
+            this->planes.x[f] = normal.x;
+            this->planes.y[f] = normal.y;
+            this->planes.z[f] = normal.z;
+            this->planes.w[f] = dot(normal, p0);
+        }
+        this->set_light(this->light);
+    }
+
+    // grayscale of each face lit by a directional light
+    void set_light(const Vec4& light) {
+        this->light = normalize(light);
+        this->shades.resize(this->mesh->face_count());
+        for (size_t f = 0; f < this->mesh->face_count(); f++) {
+            Vec4 normal = direction(this->planes.x[f], this->planes.y[f], this->planes.z[f]);
+            // keep dot product
+            float light_dp = std::max(0.1f, dot(this->light, normal));
+            // set grayscale color based on dot product
+            unsigned char grayscale = (unsigned char)std::abs(255 * light_dp);
+            this->shades[f] = SDL_Color{ grayscale, grayscale, grayscale, 255 };
+        }
+    }
+
+    // the coarsest level whose error stays under lod_pixels on screen where the
+    // mesh comes nearest the camera, with the planes and shades redone on a change
+    void select_lod() {
+        const Mesh& full = *this->lods[0];
+        Vec4 center = (full.bounds_min + full.bounds_max) * 0.5f * this->world_matrix;
+        float radius = distance(full.bounds_min, full.bounds_max) * 0.5f;
+        float nearest = std::max(this->near, distance(center, this->camera) - radius);
+        // pixels a world unit there covers, from the vertical projection scale
+        float pixels = this->proj_matrix[1].y * 0.5f * (float)this->screen_height / nearest;
+
+        size_t level = this->lod;
+        while (level > 0 && this->lods[level]->error * pixels > this->lod_pixels)
+            level--;
+        while (level + 1 < this->lods.size() && this->lods[level + 1]->error * pixels < this->lod_pixels * (1.0f - this->lod_hysteresis))
+            level++;
+        if (level == this->lod)
+            return;
+        this->lod = level;
+        this->mesh = this->lods[level].get();
+        this->set_world(this->world_matrix);
+    }
+
+    // meshlets with some part in the frustum and some face towards the camera,
+    // one test of each against their bounding sphere and normal cone in model space
+    void cull_meshlets(const Mat4& world_view_proj) {
+        Vec4 frustum[CLIP_PLANES];
+        frustum_planes(world_view_proj, frustum);
+        Vec4 camera = this->camera * Mat4::quick_inverse(this->world_matrix);
+
+        this->meshlets_visible.clear();
+        for (uint32_t i = 0; i < this->mesh->meshlets.size; i++) {
+            const Meshlet& m = this->mesh->meshlets[i];
+            bool outside = false;
+            for (const Vec4& plane : frustum)
+                outside |= dot(plane, m.center) + plane.w < -m.radius;
+            if (outside)
+                continue;
+
+            // all faces point away when even the normal in the cone turned
+            // furthest towards the camera does, by more than the radius
+            Vec4 to_center = m.center - camera;
+            float dist = length(to_center);
+            if (m.cone_cos > 0 && dist > m.radius) {
+                float cos_angle = dot(to_center, m.cone_axis) / dist;
+                float sin_angle = std::sqrt(std::max(0.0f, 1.0f - cos_angle * cos_angle));
+                if (dist * (cos_angle * m.cone_cos - sin_angle * m.cone_sin) >= m.radius)
+                    continue;
+            }
+            this->meshlets_visible.push_back(i);
+        }
+    }
+
+    // cull, clip and project faces [begin, end) onto the output buffer of one thread
+    void process(unsigned thread, size_t begin, size_t end) {
+        std::vector<uint32_t>& visible = this->visible[thread];
+        std::vector<Triangle>& out = this->thread_triangles[thread];
+
+        // only faces with the camera in front of them are drawn
+        cull_backfaces(this->planes, this->camera, begin, end, visible);
+
+        for (uint32_t f : visible) {
+            uint32_t v[3] = { this->mesh->indices[f * 3], this->mesh->indices[f * 3 + 1], this->mesh->indices[f * 3 + 2] };
+            uint8_t c0 = this->codes[v[0]], c1 = this->codes[v[1]], c2 = this->codes[v[2]];
+
+            // all outside the same plane
+            if (c0 & c1 & c2 & CLIP_FRUSTUM)
+                continue;
+
+            // inside the guard band the rasterizer scissors to the screen, so
+            // only the near and far planes and edges past the band need clipping
+            unsigned any = c0 | c1 | c2;
+            unsigned planes = any & (CLIP_NEAR | CLIP_FAR);
+            if (any & CLIP_GUARD_X)
+                planes |= any & (CLIP_X_MIN | CLIP_X_MAX);
+            if (any & CLIP_GUARD_Y)
+                planes |= any & (CLIP_Y_MIN | CLIP_Y_MAX);
+
+            Triangle tri_projected = Triangle{};
+            tri_projected.shade = this->shades[f];
+
+            // nothing to clip, the kernel already projected it
+            if (planes == 0) {
+                for (int k = 0; k < 3; k++)
+                    tri_projected.p[k] = Vec4{ this->screen.x[v[k]], this->screen.y[v[k]], this->screen.z[v[k]], this->screen.w[v[k]] };
+                tri_projected.distance = (tri_projected.p[0].z + tri_projected.p[1].z + tri_projected.p[2].z) / 3;
+                out.push_back(tri_projected);
+                continue;
+            }
+
+            // crosses a plane, clip in clip space and project what is left
+            Vec4 poly[CLIP_MAX_VERTICES];
+            for (int k = 0; k < 3; k++)
+                poly[k] = Vec4{ this->clip.x[v[k]], this->clip.y[v[k]], this->clip.z[v[k]], this->clip.w[v[k]] };
+            int count = clip_polygon(poly, 3, planes);
+            for (int k = 0; k < count; k++)
+                poly[k] = viewport(poly[k], (float)this->screen_width, (float)this->screen_height);
+            for (int k = 1; k + 1 < count; k++) {
+                tri_projected.p[0] = poly[0];
+                tri_projected.p[1] = poly[k];
+                tri_projected.p[2] = poly[k + 1];
+                tri_projected.distance = (tri_projected.p[0].z + tri_projected.p[1].z + tri_projected.p[2].z) / 3;
+                out.push_back(tri_projected);
+            }
+        }
+    }
+
+    void raster() {
+        std::vector<Triangle>& to_draw = this->triangles_to_raster;
+
+        if (this->mode == RASTER_PAINTER) {
+            // draw tris back to front, sorting small key and index pairs
+            // rather than the triangles, furthest first as the keys ascend
+            this->sort_pairs.resize(to_draw.size());
+            for (size_t i = 0; i < to_draw.size(); i++)
+                this->sort_pairs[i] = (uint64_t)~float_key(to_draw[i].distance) << 32 | i;
+            radix_sort(this->sort_pairs, this->sort_scratch);
+
+            for (uint64_t pair : this->sort_pairs) {
+                const Triangle& t = to_draw[(uint32_t)pair];
+                Ctx->draw_tri_fillf(t.shade, t.p[0].x, t.p[0].y, t.p[1].x, t.p[1].y, t.p[2].x, t.p[2].y);
+            }
+            return;
+        }
+
+        // every thread owns a band of rows and draws the triangles reaching into
+        // it, in order, so the depth test resolves ties the same way on any
+        // thread count. Triangles are binned by the rows of their vertices,
+        // which hold every pixel of their faces and edges.
+        unsigned bands = this->workers.size();
+        std::vector<size_t> band_begin(bands), band_end(bands);
+        for (unsigned k = 0; k < bands; k++) {
+            this->workers.split(this->framebuffer.height, 1, k, band_begin[k], band_end[k]);
+            this->band_triangles[k].clear();
+        }
+        for (size_t i = 0; i < to_draw.size(); i++) {
+            const Triangle& t = to_draw[i];
+            float top = std::floor(std::min({ t.p[0].y, t.p[1].y, t.p[2].y }));
+            float bottom = std::floor(std::max({ t.p[0].y, t.p[1].y, t.p[2].y }));
+            for (unsigned k = 0; k < bands; k++) {
+                if (top < (float)band_end[k] && bottom >= (float)band_begin[k])
+                    this->band_triangles[k].push_back((uint32_t)i);
+            }
+        }
+
+        bool wireframe = this->mode == RASTER_WIREFRAME;
+        this->workers.run([&](unsigned thread) {
+            int y0 = (int)band_begin[thread], y1 = (int)band_end[thread];
+            if (y0 == y1)
+                return;
+
+            const std::vector<uint32_t>& band = this->band_triangles[thread];
+            this->framebuffer.clear(pse::argb(pse::Black), y0, y1);
+            for (uint32_t i : band)
+                this->framebuffer.fill(to_draw[i], pse::argb(to_draw[i].shade), !wireframe, y0, y1, this->thread_spans[thread]);
+            if (!wireframe)
+                return;
+            for (uint32_t i : band) {
+                const Triangle& t = to_draw[i];
+                uint32_t color = pse::argb(t.shade);
+                this->framebuffer.line(t.p[0], t.p[1], color, y0, y1);
+                this->framebuffer.line(t.p[1], t.p[2], color, y0, y1);
+                this->framebuffer.line(t.p[2], t.p[0], color, y0, y1);
+            }
+        });
+        Ctx->draw_pixels(this->framebuffer.color.data(), this->framebuffer.width, this->framebuffer.height);
+    }
+
+    void update() {
+        float step = this->speed * (float)Ctx->delta_time;
+        Vec4 forward_vec = this->look_dir * step;
+        Vec4 right_vec = cross(this->look_dir, this->up_vec) * step;
+        // forward
+        if (Ctx->check_key(SDL_SCANCODE_W))
+            this->camera += forward_vec;
+        // backward
+        if (Ctx->check_key(SDL_SCANCODE_S))
+            this->camera -= forward_vec;
+        // up
+        if (Ctx->check_key(SDL_SCANCODE_SPACE))
+            this->camera.y += step;
+        // down
+        if (Ctx->check_key(SDL_SCANCODE_LSHIFT))
+            this->camera.y -= step;
+        // left
+        if (Ctx->check_key(SDL_SCANCODE_A))
+            this->camera += right_vec;
+        // right
+        if (Ctx->check_key(SDL_SCANCODE_D))
+            this->camera -= right_vec;
+        // turn left
+        if (Ctx->check_key(SDL_SCANCODE_LEFT))
+            this->yaw -= 0.1f;
+        // turn right
+        if (Ctx->check_key(SDL_SCANCODE_RIGHT))
+            this->yaw += 0.1f;
+        if (Ctx->check_key(SDL_SCANCODE_LCTRL))
+            this->speed = 300;
+        else
+            this->speed = 10;
+        // next raster mode
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_M))
+            this->mode = (RasterMode)((this->mode + 1) % RASTER_MODES);
+        // guard band or exact clipping
+        if (Ctx->check_key_invalidate(SDL_SCANCODE_G))
+            this->guard_band = this->guard_band > 1.0f ? 1.0f : TRACE_GUARD_BAND;
+
+        this->triangles_to_raster.clear();
+
+        // set up camera looking vectors
+        this->look_dir = direction(0, 0, 1) * Mat4::rotate_y(this->yaw);
+        Vec4 target_vec = this->camera + this->look_dir;
+
+        Mat4 camera_matrix = Mat4::point_at(this->camera, target_vec, this->up_vec);
+        Mat4 view_matrix = Mat4::quick_inverse(camera_matrix);
+
+        this->select_lod();
+
+        Mat4 world_view_proj = this->world_matrix * view_matrix * this->proj_matrix;
+        this->cull_meshlets(world_view_proj);
+
+        // each thread takes a range of the meshlets left, and for each sends its
+        // vertices to clip and screen space, 8 at a time, then does its faces
+        this->clip.resize(this->mesh->positions.size);
+        this->screen.resize(this->mesh->positions.size);
+        this->codes.resize(this->mesh->positions.size);
+        this->workers.run([&](unsigned thread) {
+            size_t begin, end;
+            this->workers.split(this->meshlets_visible.size(), 1, thread, begin, end);
+            this->thread_triangles[thread].clear();
+            for (size_t i = begin; i < end; i++) {
+                const Meshlet& m = this->mesh->meshlets[this->meshlets_visible[i]];
+                transform_project(world_view_proj, this->mesh->positions, m.vertex_begin, m.vertex_begin + m.vertex_count,
+                    this->clip, this->screen, this->codes, (float)this->screen_width, (float)this->screen_height, this->guard_band);
+                this->process(thread, m.face_begin, m.face_begin + m.face_count);
+            }
+        });
+
+        // merge in thread order so the frame does not depend on timing
+        for (const std::vector<Triangle>& out : this->thread_triangles)
+            this->triangles_to_raster.insert(this->triangles_to_raster.end(), out.begin(), out.end());
+
+        raster();
+    }
+};
+
+} // trace
+
+namespace Modules {
+
+void trace_setup(pse::Context& ctx)
+{
+    trace::Ctx = &ctx;
+}
+
+void trace_update(pse::Context& ctx)
+{
+    static trace::Graphics graphics = trace::Graphics{ "src/pse-modules/trace_assets/mountains.obj", ctx.screen_height, ctx.screen_width };
+    graphics.update();
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../../pse.hpp"
+
+namespace trace {
+
+using namespace pse::math;
+
+// read only array owned by something else
+template <typename T>
+struct Span {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T& operator[](size_t i) const { return data[i]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+};
+
+struct Triangle {
+    Vec4 p[3];
+    SDL_Color shade = SDL_Color{ 255, 255, 255, 255 };
+    float distance = 0;
+
+    Triangle() : p{ point(0, 0, 0), point(0, 0, 0), point(0, 0, 0) }, shade{ 255, 255, 255, 255 }, distance{ 0 } {}
+    Triangle(Vec4 v1, Vec4 v2, Vec4 v3) : p{ v1, v2, v3 }, shade{ 255, 255, 255, 255 }, distance{ 0 } {}
+};
+
+} // trace
@@ -0,0 +1,77 @@
+#include <algorithm>
+
+#include "workers.hpp"
+
+namespace trace {
+
+Workers::Workers(unsigned count)
+{
+    if (count == 0)
+        count = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 1; i < count; i++)
+        this->threads.emplace_back(&Workers::loop, this, i);
+}
+
+Workers::~Workers()
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->quit = true;
+    }
+    this->start.notify_all();
+    for (std::thread& t : this->threads)
+        t.join();
+}
+
+unsigned Workers::size() const
+{
+    return (unsigned)this->threads.size() + 1;
+}
+
+void Workers::loop(unsigned index)
+{
+    unsigned seen = 0;
+    for (;;) {
+        const std::function<void(unsigned)>* current;
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->start.wait(guard, [&] { return this->quit || this->generation != seen; });
+            if (this->quit)
+                return;
+            seen = this->generation;
+            current = this->job;
+        }
+
+        (*current)(index);
+
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (--this->pending == 0)
+            this->done.notify_one();
+    }
+}
+
+void Workers::run(const std::function<void(unsigned)>& job)
+{
+    if (!this->threads.empty()) {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->job = &job;
+        this->pending = (unsigned)this->threads.size();
+        this->generation++;
+    }
+    this->start.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->done.wait(guard, [&] { return this->pending == 0; });
+}
+
+void Workers::split(size_t count, size_t align, unsigned index, size_t& begin, size_t& end) const
+{
+    size_t blocks = (count + align - 1) / align;
+    size_t per = (blocks + this->size() - 1) / this->size();
+    begin = std::min(count, index * per * align);
+    end = std::min(count, (index + 1) * per * align);
+}
+
+} // trace
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace trace {
+
+/**
+ * Persistent pool of threads that run one job per thread and wait for all of
+ * them to finish. The calling thread takes index 0, so a pool of one thread
+ * runs everything inline and spawns nothing.
+ */
+class Workers {
+private:
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable done;
+    const std::function<void(unsigned)>* job = nullptr;
+    unsigned generation = 0; // bumped every run so sleeping threads see new work
+    unsigned pending = 0;    // threads still running the current job
+    bool quit = false;
+
+    void loop(unsigned index);
+public:
+    // 0 uses one thread per hardware thread
+    Workers(unsigned count = 0);
+    ~Workers();
+    Workers(const Workers&) = delete;
+    Workers& operator=(const Workers&) = delete;
+
+    unsigned size() const;
+
+    // call job(index) once on every thread, returns when all have returned
+    void run(const std::function<void(unsigned)>& job);
+
+    // the part of [0, count) handled by index, boundaries are multiples of align
+    void split(size_t count, size_t align, unsigned index, size_t& begin, size_t& end) const;
+};
+
+} // trace
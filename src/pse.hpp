@@ -2,5 +2,7 @@
 
 #include "ctx.hpp"
 #include "colors.hpp"
+#include "frame_stats.hpp"
+#include "math.hpp"
 #include "types.hpp"
 #include "util.hpp"
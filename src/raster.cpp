@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PSE_RASTER_SSE2
+#endif
+
+#include "raster.hpp"
+
+namespace pse {
+
+#define RASTER_BLOCK 8
+
+namespace {
+
+// edge function e(x, y) = a * x + b * y + c of the edge from v1 to v2 at 28.4
+// points, not negative inside a triangle of positive area
+struct EdgeFn {
+    int64_t a, b, c;
+};
+
+// with the top-left bias applied, samples on a non top-left edge come out negative
+EdgeFn edge_setup(int x1, int y1, int x2, int y2)
+{
+    EdgeFn e;
+    e.a = (int64_t)y1 - y2;
+    e.b = (int64_t)x2 - x1;
+    e.c = -(e.a * x1 + e.b * y1);
+
+    // pixels exactly on an edge belong to the triangle only for top/left edges
+    bool top_left = (y2 - y1) < 0 || ((y2 - y1) == 0 && (x2 - x1) > 0);
+    if (!top_left)
+        e.c -= 1;
+    return e;
+}
+
+// the edge value at the center of pixel (px, py)
+inline int64_t edge_eval(const EdgeFn& e, int px, int py)
+{
+    int64_t x = ((int64_t)px << PSE_SUBPIXEL_BITS) + PSE_SUBPIXEL_ONE / 2;
+    int64_t y = ((int64_t)py << PSE_SUBPIXEL_BITS) + PSE_SUBPIXEL_ONE / 2;
+    return e.a * x + e.b * y + e.c;
+}
+
+// floor of n / d and what is left of it, 0 <= rem < d, for d > 0
+struct FloorDiv {
+    int64_t quot;
+    int64_t rem;
+
+    FloorDiv(int64_t n, int64_t d) : quot(n / d), rem(n % d) {
+        if (rem < 0) {
+            rem += d;
+            quot--;
+        }
+    }
+};
+
+/**
+ * One edge of a triangle walked down its rows. A pixel center x of a row is
+ * inside where a * x + rest >= 0, rest being the rest of the edge function,
+ * so with x = 16 * px + 8:
+ *  a > 0: px >= (-rest - 8a) / 16a, spans start at the ceiling of it
+ *  a < 0: px <= (rest + 8a) / -16a, spans end after the floor of it
+ * The numerator is linear in the row, so its quotient and remainder are
+ * stepped with no division past the first row.
+ */
+struct EdgeWalk {
+    int kind; // 1 starts spans, -1 ends them, 0 is horizontal and keeps or drops whole rows
+    int64_t divisor;
+    int64_t quot, rem;
+    int64_t step_quot, step_rem;
+    int64_t value, step_value; // the edge value at x = 0, all that matters when horizontal
+
+    EdgeWalk(const EdgeFn& e, int row) {
+        int64_t y = ((int64_t)row << PSE_SUBPIXEL_BITS) + PSE_SUBPIXEL_ONE / 2;
+        this->value = e.b * y + e.c;
+        this->step_value = e.b * PSE_SUBPIXEL_ONE;
+        this->kind = e.a > 0 ? 1 : e.a < 0 ? -1 : 0;
+
+        int64_t a = std::abs(e.a);
+        int64_t sign = this->kind > 0 ? -1 : 1;
+        this->divisor = std::max<int64_t>(a * PSE_SUBPIXEL_ONE, 1);
+        FloorDiv start(sign * this->value - a * (PSE_SUBPIXEL_ONE / 2), this->divisor);
+        FloorDiv step(sign * this->step_value, this->divisor);
+        this->quot = start.quot;
+        this->rem = start.rem;
+        this->step_quot = step.quot;
+        this->step_rem = step.rem;
+    }
+
+    // first pixel inside when kind > 0, one past the last when kind < 0
+    int64_t bound() const {
+        return this->kind > 0 ? this->quot + (this->rem != 0) : this->quot + 1;
+    }
+
+    void next_row() {
+        this->value += this->step_value;
+        this->quot += this->step_quot;
+        this->rem += this->step_rem;
+        if (this->rem >= this->divisor) {
+            this->rem -= this->divisor;
+            this->quot++;
+        }
+    }
+};
+
+// per pixel and per row steps of the edge values, in the 32 bits the blocks step them in
+struct BlockEdge {
+    int32_t step_x;
+    int32_t step_y;
+};
+
+// bit i set when pixel x + i of a row is inside all three edges
+inline unsigned row_mask(int32_t e0, int32_t e1, int32_t e2, const BlockEdge *edges)
+{
+#if defined(__AVX2__)
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i v0 = _mm256_add_epi32(_mm256_set1_epi32(e0), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(edges[0].step_x)));
+    __m256i v1 = _mm256_add_epi32(_mm256_set1_epi32(e1), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(edges[1].step_x)));
+    __m256i v2 = _mm256_add_epi32(_mm256_set1_epi32(e2), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(edges[2].step_x)));
+    __m256i any = _mm256_or_si256(_mm256_or_si256(v0, v1), v2);
+    return ~(unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(any)) & 0xff;
+#elif defined(PSE_RASTER_SSE2)
+    int32_t s0 = edges[0].step_x, s1 = edges[1].step_x, s2 = edges[2].step_x;
+    __m128i lo = _mm_or_si128(_mm_or_si128(
+        _mm_setr_epi32(e0, e0 + s0, e0 + 2 * s0, e0 + 3 * s0),
+        _mm_setr_epi32(e1, e1 + s1, e1 + 2 * s1, e1 + 3 * s1)),
+        _mm_setr_epi32(e2, e2 + s2, e2 + 2 * s2, e2 + 3 * s2));
+    __m128i hi = _mm_or_si128(_mm_or_si128(
+        _mm_setr_epi32(e0 + 4 * s0, e0 + 5 * s0, e0 + 6 * s0, e0 + 7 * s0),
+        _mm_setr_epi32(e1 + 4 * s1, e1 + 5 * s1, e1 + 6 * s1, e1 + 7 * s1)),
+        _mm_setr_epi32(e2 + 4 * s2, e2 + 5 * s2, e2 + 6 * s2, e2 + 7 * s2));
+    unsigned outside = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(lo))
+                     | (unsigned)_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4;
+    return ~outside & 0xff;
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < RASTER_BLOCK; i++) {
+        if ((e0 | e1 | e2) >= 0)
+            mask |= 1u << i;
+        e0 += edges[0].step_x;
+        e1 += edges[1].step_x;
+        e2 += edges[2].step_x;
+    }
+    return mask;
+#endif
+}
+
+// write color to the pixels of row[0..8) selected by mask, all 8 must be in bounds
+inline void row_store(uint32_t *row, unsigned mask, uint32_t color)
+{
+#if defined(__AVX2__)
+    const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i select = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)mask), bits), bits);
+    _mm256_maskstore_epi32((int *)row, select, _mm256_set1_epi32((int)color));
+#elif defined(PSE_RASTER_SSE2)
+    const __m128i bits_lo = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i bits_hi = _mm_setr_epi32(16, 32, 64, 128);
+    __m128i m = _mm_set1_epi32((int)mask);
+    __m128i c = _mm_set1_epi32((int)color);
+    __m128i sel_lo = _mm_cmpeq_epi32(_mm_and_si128(m, bits_lo), bits_lo);
+    __m128i sel_hi = _mm_cmpeq_epi32(_mm_and_si128(m, bits_hi), bits_hi);
+    __m128i *lo = (__m128i *)row;
+    __m128i *hi = (__m128i *)(row + 4);
+    _mm_storeu_si128(lo, _mm_or_si128(_mm_and_si128(sel_lo, c), _mm_andnot_si128(sel_lo, _mm_loadu_si128(lo))));
+    _mm_storeu_si128(hi, _mm_or_si128(_mm_and_si128(sel_hi, c), _mm_andnot_si128(sel_hi, _mm_loadu_si128(hi))));
+#else
+    for (int i = 0; i < RASTER_BLOCK; i++) {
+        if (mask & (1u << i))
+            row[i] = color;
+    }
+#endif
+}
+
+} // namespace
+
+void raster_spans(int x1, int y1, int x2, int y2, int x3, int y3, int width, int height, std::vector<SDL_Rect>& spans, int first_row)
+{
+    // wind so the inside of every edge is positive
+    int64_t area = (int64_t)(x2 - x1) * (y3 - y1) - (int64_t)(y2 - y1) * (x3 - x1);
+    if (area == 0) return;
+    if (area < 0) {
+        std::swap(x2, x3);
+        std::swap(y2, y3);
+    }
+
+    // rows with their center within the triangle's height
+    int64_t top = std::min({ y1, y2, y3 });
+    int64_t bottom = std::max({ y1, y2, y3 });
+    int row_begin = (int)std::max<int64_t>((top + PSE_SUBPIXEL_ONE / 2 - 1) >> PSE_SUBPIXEL_BITS, first_row);
+    int row_end = (int)std::min<int64_t>(((bottom - PSE_SUBPIXEL_ONE / 2) >> PSE_SUBPIXEL_BITS) + 1, height);
+    if (row_begin >= row_end) return;
+
+    EdgeWalk edges[3] = {
+        EdgeWalk(edge_setup(x1, y1, x2, y2), row_begin),
+        EdgeWalk(edge_setup(x2, y2, x3, y3), row_begin),
+        EdgeWalk(edge_setup(x3, y3, x1, y1), row_begin),
+    };
+    for (int y = row_begin; y < row_end; y++) {
+        int64_t left = 0;
+        int64_t right = width;
+        for (EdgeWalk& e : edges) {
+            if (e.kind > 0)
+                left = std::max(left, e.bound());
+            else if (e.kind < 0)
+                right = std::min(right, e.bound());
+            else if (e.value < 0)
+                right = 0;
+            e.next_row();
+        }
+        if (left < right)
+            spans.push_back(SDL_Rect{ (int)left, y, (int)(right - left), 1 });
+    }
+}
+
+bool raster_blocks(int x1, int y1, int x2, int y2, int x3, int y3, int width, int height, uint32_t color, uint32_t *pixels)
+{
+    // wind so the inside of every edge is positive
+    int64_t area = (int64_t)(x2 - x1) * (y3 - y1) - (int64_t)(y2 - y1) * (x3 - x1);
+    if (area == 0) return true;
+    if (area < 0) {
+        std::swap(x2, x3);
+        std::swap(y2, y3);
+    }
+
+    // bounds in whole pixels, clipped to the screen and aligned to blocks
+    auto pixel_floor = [](int v) { return (int)((int64_t)v >> PSE_SUBPIXEL_BITS); };
+    int min_x = std::max(pixel_floor(std::min({ x1, x2, x3 })), 0);
+    int min_y = std::max(pixel_floor(std::min({ y1, y2, y3 })), 0);
+    int max_x = std::min(pixel_floor(std::max({ x1, x2, x3 })), width - 1);
+    int max_y = std::min(pixel_floor(std::max({ y1, y2, y3 })), height - 1);
+    if (min_x > max_x || min_y > max_y) return true;
+    min_x &= ~(RASTER_BLOCK - 1);
+    min_y &= ~(RASTER_BLOCK - 1);
+    int end_x = (max_x | (RASTER_BLOCK - 1)) + 1;
+    int end_y = (max_y | (RASTER_BLOCK - 1)) + 1;
+
+    // the same edge functions as raster_spans, so both cover the same pixels
+    EdgeFn fns[3] = {
+        edge_setup(x1, y1, x2, y2),
+        edge_setup(x2, y2, x3, y3),
+        edge_setup(x3, y3, x1, y1),
+    };
+
+    // edge values are stepped in 32 bits, huge triangles are left to raster_spans
+    BlockEdge edges[3];
+    for (int i = 0; i < 3; i++) {
+        const EdgeFn& e = fns[i];
+        int64_t corners[4] = {
+            edge_eval(e, min_x, min_y), edge_eval(e, end_x, min_y),
+            edge_eval(e, min_x, end_y), edge_eval(e, end_x, end_y),
+        };
+        for (int64_t v : corners) {
+            if (v > INT32_MAX / 2 || v < INT32_MIN / 2)
+                return false;
+        }
+        if (std::abs(e.a) * PSE_SUBPIXEL_ONE * RASTER_BLOCK > INT32_MAX / 4
+            || std::abs(e.b) * PSE_SUBPIXEL_ONE * RASTER_BLOCK > INT32_MAX / 4)
+            return false;
+        edges[i].step_x = (int32_t)(e.a * PSE_SUBPIXEL_ONE);
+        edges[i].step_y = (int32_t)(e.b * PSE_SUBPIXEL_ONE);
+    }
+
+    const int last = RASTER_BLOCK - 1;
+    for (int by = min_y; by < end_y; by += RASTER_BLOCK) {
+        int rows = std::min(RASTER_BLOCK, height - by);
+
+        for (int bx = min_x; bx < end_x; bx += RASTER_BLOCK) {
+            int cols = std::min(RASTER_BLOCK, width - bx);
+
+            int32_t e[3];
+            bool reject = false;
+            bool accept = true;
+            for (int i = 0; i < 3; i++) {
+                e[i] = (int32_t)edge_eval(fns[i], bx, by);
+                // the extremes of a linear function over a block are at its corners
+                int32_t dx = edges[i].step_x * last;
+                int32_t dy = edges[i].step_y * last;
+                int32_t lo = e[i] + std::min(dx, 0) + std::min(dy, 0);
+                int32_t hi = e[i] + std::max(dx, 0) + std::max(dy, 0);
+                if (hi < 0) reject = true;
+                if (lo < 0) accept = false;
+            }
+            if (reject) continue;
+
+            if (accept) {
+                for (int y = 0; y < rows; y++) {
+                    uint32_t *row = &pixels[(size_t)(by + y) * width + bx];
+                    std::fill(row, row + cols, color);
+                }
+                continue;
+            }
+
+            for (int y = 0; y < rows; y++) {
+                unsigned mask = row_mask(e[0], e[1], e[2], edges);
+                uint32_t *row = &pixels[(size_t)(by + y) * width + bx];
+                if (cols == RASTER_BLOCK) {
+                    if (mask == 0xff)
+                        std::fill(row, row + RASTER_BLOCK, color);
+                    else if (mask)
+                        row_store(row, mask, color);
+                }
+                else {
+                    for (int x = 0; x < cols; x++) {
+                        if (mask & (1u << x))
+                            row[x] = color;
+                    }
+                }
+                e[0] += edges[0].step_y;
+                e[1] += edges[1].step_y;
+                e[2] += edges[2].step_y;
+            }
+        }
+    }
+    return true;
+}
+
+} // pse
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <SDL2/SDL_rect.h>
+
+namespace pse {
+
+/**
+ * Triangle coverage shared by the rasterizers of Context. Vertices are 28.4
+ * fixed point, pixels are sampled at their centers and a top-left fill rule
+ * decides samples exactly on an edge, so triangles sharing an edge never
+ * overlap or leave gaps. Nothing here touches SDL beyond its types.
+ */
+
+// subpixel precision of triangle vertices, 28.4 fixed point
+#define PSE_SUBPIXEL_BITS 4
+#define PSE_SUBPIXEL_ONE (1 << PSE_SUBPIXEL_BITS)
+
+/**
+ * Append one single row SDL_Rect per row of the triangle covered within a
+ * width x height screen, from first_row on. Span ends are stepped per row
+ * with an integer quotient and remainder, so they are exactly where the edge
+ * functions change sign.
+ */
+void raster_spans(int x1, int y1, int x2, int y2, int x3, int y3, int width, int height, std::vector<SDL_Rect>& spans, int first_row = 0);
+
+/**
+ * Half-space fill of the same pixels as raster_spans into a width x height
+ * ARGB8888 buffer. The screen is walked in 8x8 blocks of the triangle's
+ * bounds: a block outside any edge is skipped, a block inside all three is
+ * filled outright, and the rest are filled a row of 8 pixels at a time from
+ * a vector mask of the edge functions. False, with nothing drawn, when the
+ * triangle is too large to step its edges in 32 bits.
+ */
+bool raster_blocks(int x1, int y1, int x2, int y2, int x3, int y3, int width, int height, uint32_t color, uint32_t *pixels);
+
+} // pse
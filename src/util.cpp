@@ -3,6 +3,19 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PSE_MAPPED_FILE_MMAP
+#endif
 
 #include "util.hpp"
 
@@ -84,24 +97,132 @@ double fast_cos(double x)
     return fast_sin(x + 3.14159265358979323846 / 2.0);
 }
 
-char* file_read(const char* fname)
+namespace pse {
+
+MappedFile::MappedFile(const char* path, Access access)
+{
+    open(path, access);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
 {
-    char* buf = NULL;
-    long length;
-    FILE* f = fopen(fname, "rb");
-
-    if (f) {
-        fseek(f, 0, SEEK_END);
-        length = ftell(f);
-        fseek(f, 0, SEEK_SET);
-        buf = (char *)malloc(length);
-        if (buf) {
-            (void)fread(buf, 1, length, f);
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        bytes = other.bytes;
+        length = other.length;
+        opened = other.opened;
+        mapped = other.mapped;
+        buffer = std::move(other.buffer); // keeps its storage, so bytes stays valid
+        other.bytes = nullptr;
+        other.length = 0;
+        other.opened = false;
+        other.mapped = false;
+    }
+    return *this;
+}
+
+bool MappedFile::open(const char* path, Access access)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+                bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+            length = (size_t)size.QuadPart;
         }
-        fclose(f);
+        CloseHandle(file);
+        if (bytes) {
+            opened = mapped = true;
+            return true;
+        }
+    }
+#elif defined(PSE_MAPPED_FILE_MMAP)
+    int fd = ::open(path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                bytes = (const char*)data;
+                length = (size_t)st.st_size;
+            }
+        }
+        ::close(fd);
+        if (bytes) {
+            opened = mapped = true;
+            advise(access);
+            return true;
+        }
+    }
+#endif
+
+    // empty files, pipes and platforms without mapping are read instead
+    (void)access;
+    length = 0;
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    char chunk[64 * 1024];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buffer.insert(buffer.end(), chunk, chunk + read);
+    bool failed = ferror(f) != 0;
+    fclose(f);
+    if (failed) {
+        buffer.clear();
+        return false;
     }
-    else {
-        return NULL;
+    bytes = buffer.data();
+    length = buffer.size();
+    opened = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapped) {
+#if defined(_WIN32)
+        UnmapViewOfFile(bytes);
+#elif defined(PSE_MAPPED_FILE_MMAP)
+        munmap((void*)bytes, length);
+#endif
     }
-    return buf;
-}
\ No newline at end of file
+    buffer.clear();
+    buffer.shrink_to_fit();
+    bytes = nullptr;
+    length = 0;
+    opened = false;
+    mapped = false;
+}
+
+void MappedFile::advise(Access access)
+{
+#if defined(PSE_MAPPED_FILE_MMAP)
+    if (!mapped)
+        return;
+    int advice = access == ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL : access == ACCESS_RANDOM ? MADV_RANDOM : MADV_NORMAL;
+    madvise((void*)bytes, length, advice);
+#else
+    // Windows has no equivalent hint for a mapped view
+    (void)access;
+#endif
+}
+
+} // pse
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <cstring>
+#include <string_view>
+#include <vector>
 
 #define streq(str0, str1) (strcmp(str0, str1) == 0)
 
@@ -29,4 +32,48 @@ double fast_sin(double x);
 
 double fast_cos(double x);
 
-char* file_read(const char* fname);
+namespace pse {
+
+/**
+ * Read only contents of a whole file, mapped into memory where the platform
+ * allows and read into a buffer otherwise, so loaders parse straight out of
+ * the page cache. The contents stay valid until the file is closed or the
+ * object destroyed.
+ */
+class MappedFile {
+public:
+    // how the contents will be read, a hint for the kernel's read ahead
+    enum Access {
+        ACCESS_NORMAL,
+        ACCESS_SEQUENTIAL, // front to back once, read ahead aggressively
+        ACCESS_RANDOM,     // scattered, do not read ahead
+    };
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+    bool opened = false;
+    bool mapped = false;
+    std::vector<char> buffer{}; // contents when not mapped
+
+public:
+    MappedFile() {}
+    MappedFile(const char* path, Access access = ACCESS_NORMAL);
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path, Access access = ACCESS_NORMAL); // false when it cannot be read
+    void close();
+    void advise(Access access); // only affects mapped files
+
+    bool is_open() const { return opened; }
+    bool is_mapped() const { return mapped; }
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+    std::string_view view() const { return std::string_view(bytes, length); }
+};
+
+} // pse
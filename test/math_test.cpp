@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "../src/math.hpp"
+
+/**
+ * Checks the Vec4 and Mat4 operations of src/math.hpp against the double
+ * precision scalar code they replaced in the trace module, ported below
+ * with exact sqrt and trigonometry in place of its fast approximations.
+ * Built once as is and once with PSE_MATH_SCALAR, so both paths are
+ * covered. Exits non zero on any difference beyond float rounding.
+ */
+
+using namespace pse::math;
+
+#define TEST_CASES 2000
+#define TEST_EPSILON 1e-4
+
+// the old row vector and matrix, 1x4 * 4x4
+struct RefVec {
+    double x, y, z, w;
+};
+
+struct RefMat {
+    double m[4][4];
+};
+
+static RefVec ref_matmul(const RefVec& v, const RefMat& m)
+{
+    return RefVec{
+        v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + v.w * m.m[3][0],
+        v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + v.w * m.m[3][1],
+        v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + v.w * m.m[3][2],
+        v.x * m.m[0][3] + v.y * m.m[1][3] + v.z * m.m[2][3] + v.w * m.m[3][3],
+    };
+}
+
+static RefMat ref_matmul(const RefMat& m1, const RefMat& m2)
+{
+    RefMat m;
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            m.m[r][c] = m1.m[r][0] * m2.m[0][c] + m1.m[r][1] * m2.m[1][c]
+                      + m1.m[r][2] * m2.m[2][c] + m1.m[r][3] * m2.m[3][c];
+        }
+    }
+    return m;
+}
+
+static RefMat ref_project(double fov, double aspect_ratio, double near, double far)
+{
+    double fov_rad = 1.0 / tan(fov * 0.5 * M_PI / 180);
+    RefMat m = {};
+    m.m[0][0] = aspect_ratio * fov_rad;
+    m.m[1][1] = fov_rad;
+    m.m[2][2] = far / (far - near);
+    m.m[3][2] = (-1.0 * far * near) / (far - near);
+    m.m[2][3] = 1.0;
+    m.m[3][3] = 0.0;
+    return m;
+}
+
+// the old one also divided w, which normalize now keeps
+static RefVec ref_normal(const RefVec& v)
+{
+    double m = sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return RefVec{ v.x / m, v.y / m, v.z / m, v.w };
+}
+
+/**
+ * The old quick_inverse took the translation against the columns of the
+ * rotation, -(t . column i), where the inverse needs -(t . row i). The two
+ * agree only when the rotation is symmetric, which is why the math changed.
+ */
+static RefMat ref_old_quick_inverse(const RefMat& m)
+{
+    return RefMat{ {
+        { m.m[0][0], m.m[1][0], m.m[2][0], 0 },
+        { m.m[0][1], m.m[1][1], m.m[2][1], 0 },
+        { m.m[0][2], m.m[1][2], m.m[2][2], 0 },
+        {
+            -1.0 * (m.m[3][0] * m.m[0][0] + m.m[3][1] * m.m[1][0] + m.m[3][2] * m.m[2][0]),
+            -1.0 * (m.m[3][0] * m.m[0][1] + m.m[3][1] * m.m[1][1] + m.m[3][2] * m.m[2][1]),
+            -1.0 * (m.m[3][0] * m.m[0][2] + m.m[3][1] * m.m[1][2] + m.m[3][2] * m.m[2][2]),
+            1.0,
+        },
+    } };
+}
+
+// general inverse by Gauss-Jordan elimination with partial pivoting
+static RefMat ref_inverse(RefMat m)
+{
+    RefMat inv = { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+    for (int c = 0; c < 4; c++) {
+        int pivot = c;
+        for (int r = c + 1; r < 4; r++) {
+            if (fabs(m.m[r][c]) > fabs(m.m[pivot][c]))
+                pivot = r;
+        }
+        for (int k = 0; k < 4; k++) {
+            std::swap(m.m[c][k], m.m[pivot][k]);
+            std::swap(inv.m[c][k], inv.m[pivot][k]);
+        }
+        double d = m.m[c][c];
+        for (int k = 0; k < 4; k++) {
+            m.m[c][k] /= d;
+            inv.m[c][k] /= d;
+        }
+        for (int r = 0; r < 4; r++) {
+            if (r == c)
+                continue;
+            double f = m.m[r][c];
+            for (int k = 0; k < 4; k++) {
+                m.m[r][k] -= f * m.m[c][k];
+                inv.m[r][k] -= f * inv.m[c][k];
+            }
+        }
+    }
+    return inv;
+}
+
+static RefVec ref(const Vec4& v)
+{
+    return RefVec{ v.x, v.y, v.z, v.w };
+}
+
+static RefMat ref(const Mat4& m)
+{
+    RefMat out;
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++)
+            out.m[r][c] = m[r][c];
+    }
+    return out;
+}
+
+static int checks = 0;
+static int failures = 0;
+
+static bool approx(double expected, double got, double scale)
+{
+    return fabs(expected - got) <= TEST_EPSILON * std::max(1.0, scale);
+}
+
+static void check(const char* name, int i, const RefVec& expected, const Vec4& got)
+{
+    double scale = std::max({ fabs(expected.x), fabs(expected.y), fabs(expected.z), fabs(expected.w) });
+    checks++;
+    if (approx(expected.x, got.x, scale) && approx(expected.y, got.y, scale)
+        && approx(expected.z, got.z, scale) && approx(expected.w, got.w, scale))
+        return;
+    if (failures++ < 5) {
+        printf("%s %d: expected (%g, %g, %g, %g) got (%g, %g, %g, %g)\n", name, i,
+            expected.x, expected.y, expected.z, expected.w, got.x, got.y, got.z, got.w);
+    }
+}
+
+static void check(const char* name, int i, const RefMat& expected, const Mat4& got)
+{
+    for (int r = 0; r < 4; r++) {
+        const double* e = expected.m[r];
+        check(name, i, RefVec{ e[0], e[1], e[2], e[3] }, got[r]);
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+    auto random_vec = [&]() { return Vec4{ value(rng), value(rng), value(rng), value(rng) }; };
+    auto random_mat = [&]() { return Mat4{ random_vec(), random_vec(), random_vec(), random_vec() }; };
+    auto random_rigid = [&]() {
+        return Mat4::rotate_x(angle(rng)) * Mat4::rotate_y(angle(rng)) * Mat4::rotate_z(angle(rng))
+            * Mat4::translate(value(rng), value(rng), value(rng));
+    };
+    const RefMat identity = ref(Mat4::identity());
+
+    for (int i = 0; i < TEST_CASES; i++) {
+        Vec4 v = random_vec();
+        Mat4 a = random_mat();
+        Mat4 b = random_mat();
+        check("vec * mat", i, ref_matmul(ref(v), ref(a)), v * a);
+        check("mat * mat", i, ref_matmul(ref(a), ref(b)), a * b);
+
+        Vec4 d = direction(value(rng), value(rng), value(rng));
+        check("normalize", i, ref_normal(ref(d)), normalize(d));
+
+        std::uniform_real_distribution<float> fov(30.0f, 120.0f);
+        std::uniform_real_distribution<float> aspect(0.5f, 2.0f);
+        float f = fov(rng), ratio = aspect(rng), near = 0.1f, far = 1000.0f;
+        Mat4 project = Mat4::project(f, ratio, near, far);
+        check("project", i, ref_project(f, ratio, near, far), project);
+        Vec4 p = point(value(rng), value(rng), value(rng) + 200.0f);
+        check("point * project", i, ref_matmul(ref(p), ref_project(f, ratio, near, far)), p * project);
+
+        Mat4 m = random_rigid();
+        Mat4 inv = Mat4::quick_inverse(m);
+        check("quick_inverse", i, ref_inverse(ref(m)), inv);
+        check("m * quick_inverse", i, identity, m * inv);
+        check("quick_inverse * m", i, identity, inv * m);
+
+        // where the old formula was right, the new one gives the same
+        Mat4 t = Mat4::translate(value(rng), value(rng), value(rng));
+        check("quick_inverse translate", i, ref_old_quick_inverse(ref(t)), Mat4::quick_inverse(t));
+        Mat4 flip = Mat4::rotate_x(3.14159265f) * Mat4::translate(value(rng), value(rng), value(rng));
+        check("quick_inverse symmetric", i, ref_old_quick_inverse(ref(flip)), Mat4::quick_inverse(flip));
+    }
+
+#ifdef PSE_MATH_SSE
+    const char* path = "sse";
+#else
+    const char* path = "scalar";
+#endif
+    printf("math_test (%s): %d checks, %d failed\n", path, checks, failures);
+    return failures ? 1 : 0;
+}
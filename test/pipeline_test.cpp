@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../src/pse-modules/trace/pipeline.hpp"
+
+/**
+ * Checks the painter mode sort of the trace pipeline: radix_sort must order
+ * key << 32 | index pairs the same as a stable sort on the key, and
+ * float_key must order the same as the floats it is made from. Exits non
+ * zero on any difference.
+ */
+
+using namespace trace;
+
+#define TEST_ROUNDS 200
+
+static int failures = 0;
+
+static void check(const char* name, int round, bool ok)
+{
+    if (!ok && failures++ < 5)
+        printf("%s: round %d differs\n", name, round);
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    std::vector<uint64_t> pairs, expected, scratch;
+
+    for (int round = 0; round < TEST_ROUNDS; round++) {
+        // depths as the painter mode keys them, with ties and with keys
+        // sharing their high bytes so passes are skipped
+        std::uniform_int_distribution<size_t> size(0, 5000);
+        std::uniform_real_distribution<float> depth(round % 2 ? 0.9f : -1000.0f, round % 2 ? 1.0f : 1000.0f);
+        std::uniform_int_distribution<int> tie(0, 3);
+        std::vector<float> depths(size(rng));
+        for (size_t i = 0; i < depths.size(); i++)
+            depths[i] = i > 0 && tie(rng) == 0 ? depths[i - 1] : depth(rng);
+
+        pairs.resize(depths.size());
+        for (size_t i = 0; i < depths.size(); i++)
+            pairs[i] = (uint64_t)~float_key(depths[i]) << 32 | i;
+        expected = pairs;
+        std::stable_sort(expected.begin(), expected.end(), [](uint64_t a, uint64_t b) { return (a >> 32) < (b >> 32); });
+        radix_sort(pairs, scratch);
+        check("radix_sort", round, pairs == expected);
+
+        // furthest first, as raster draws them
+        bool ordered = true;
+        for (size_t i = 1; i < pairs.size(); i++)
+            ordered &= depths[(uint32_t)pairs[i - 1]] >= depths[(uint32_t)pairs[i]];
+        check("float_key order", round, ordered);
+    }
+
+    printf("pipeline_test: %d rounds, %d failed\n", TEST_ROUNDS, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../src/raster.hpp"
+
+/**
+ * Checks the triangle coverage of src/raster.cpp against a brute force
+ * reference that tests every pixel center against the exact edge functions
+ * and the top-left rule, and the pixels of the block and scanline paths
+ * against each other. Exits non zero on any difference.
+ */
+
+using namespace pse;
+
+// not multiples of the 8x8 blocks, so blocks are cut off at the screen edge
+#define TEST_WIDTH 157
+#define TEST_HEIGHT 118
+#define TEST_TRIANGLES 20000
+// rows of the band checked on its own
+#define TEST_BAND_BEGIN 37
+#define TEST_BAND_END 81
+
+struct Tri {
+    int x[3], y[3]; // 28.4
+};
+
+typedef std::vector<uint8_t> Coverage; // TEST_WIDTH * TEST_HEIGHT, 1 where covered
+
+static Coverage reference(Tri t)
+{
+    Coverage out(TEST_WIDTH * TEST_HEIGHT);
+    int64_t area = (int64_t)(t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (int64_t)(t.y[1] - t.y[0]) * (t.x[2] - t.x[0]);
+    if (area == 0)
+        return out;
+    if (area < 0) {
+        std::swap(t.x[1], t.x[2]);
+        std::swap(t.y[1], t.y[2]);
+    }
+    for (int py = 0; py < TEST_HEIGHT; py++) {
+        for (int px = 0; px < TEST_WIDTH; px++) {
+            int64_t cx = px * PSE_SUBPIXEL_ONE + PSE_SUBPIXEL_ONE / 2;
+            int64_t cy = py * PSE_SUBPIXEL_ONE + PSE_SUBPIXEL_ONE / 2;
+            bool inside = true;
+            for (int i = 0; i < 3 && inside; i++) {
+                int j = (i + 1) % 3;
+                int64_t dx = t.x[j] - t.x[i], dy = t.y[j] - t.y[i];
+                int64_t w = dx * (cy - t.y[i]) - dy * (cx - t.x[i]);
+                bool top_left = dy < 0 || (dy == 0 && dx > 0);
+                inside = w > 0 || (w == 0 && top_left);
+            }
+            out[py * TEST_WIDTH + px] = inside;
+        }
+    }
+    return out;
+}
+
+// rows [first_row, height) only, the way the trace framebuffer draws in bands
+static Coverage spans(const Tri& t, int first_row = 0, int height = TEST_HEIGHT)
+{
+    Coverage out(TEST_WIDTH * TEST_HEIGHT);
+    std::vector<SDL_Rect> rects;
+    raster_spans(t.x[0], t.y[0], t.x[1], t.y[1], t.x[2], t.y[2], TEST_WIDTH, height, rects, first_row);
+    for (const SDL_Rect& r : rects) {
+        for (int x = r.x; x < r.x + r.w; x++)
+            out[r.y * TEST_WIDTH + x]++;
+    }
+    return out;
+}
+
+static Coverage blocks(const Tri& t)
+{
+    std::vector<uint32_t> pixels(TEST_WIDTH * TEST_HEIGHT);
+    Coverage out(TEST_WIDTH * TEST_HEIGHT);
+    // never for triangles this small, mark them all so it fails if it does
+    if (!raster_blocks(t.x[0], t.y[0], t.x[1], t.y[1], t.x[2], t.y[2], TEST_WIDTH, TEST_HEIGHT, 0xffffffff, pixels.data()))
+        return Coverage(TEST_WIDTH * TEST_HEIGHT, 2);
+    for (size_t i = 0; i < pixels.size(); i++)
+        out[i] = pixels[i] != 0;
+    return out;
+}
+
+static Tri fixed(float x1, float y1, float x2, float y2, float x3, float y3)
+{
+    auto f = [](float v) { return (int)lroundf(v * PSE_SUBPIXEL_ONE); };
+    return Tri{ { f(x1), f(x2), f(x3) }, { f(y1), f(y2), f(y3) } };
+}
+
+static int failures = 0;
+
+static void check(const char* name, const Tri& t, const Coverage& expected, const Coverage& got)
+{
+    if (expected == got)
+        return;
+    if (failures++ < 5) {
+        for (int i = 0; i < TEST_WIDTH * TEST_HEIGHT; i++) {
+            if (expected[i] != got[i]) {
+                printf("%s: (%d,%d)(%d,%d)(%d,%d) pixel (%d,%d) expected %d got %d\n", name,
+                    t.x[0], t.y[0], t.x[1], t.y[1], t.x[2], t.y[2], i % TEST_WIDTH, i / TEST_WIDTH, expected[i], got[i]);
+                break;
+            }
+        }
+    }
+}
+
+int main()
+{
+    std::vector<Tri> tris;
+    // pixel (59, 116) is strictly inside and was once missed
+    tris.push_back(fixed(98.61f, 42.41f, 55.55f, 138.15f, 68.86f, 65.00f));
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> x(-20.0f, TEST_WIDTH + 20.0f);
+    std::uniform_real_distribution<float> y(-20.0f, TEST_HEIGHT + 20.0f);
+    std::uniform_int_distribution<int> grid(-2, 20);
+    for (int i = 0; i < TEST_TRIANGLES; i++) {
+        // every fourth on whole and half pixels, where samples land on edges
+        if (i % 4 == 0)
+            tris.push_back(fixed(grid(rng) * 8.0f, grid(rng) * 6.0f, grid(rng) * 8.0f, grid(rng) * 6.0f, grid(rng) * 8.0f, grid(rng) * 6.0f));
+        else
+            tris.push_back(fixed(x(rng), y(rng), x(rng), y(rng), x(rng), y(rng)));
+    }
+
+    for (const Tri& t : tris) {
+        Coverage scanline = spans(t);
+        check("raster_spans", t, reference(t), scanline);
+        check("raster_blocks", t, scanline, blocks(t));
+
+        Coverage band = scanline;
+        std::fill(band.begin(), band.begin() + TEST_BAND_BEGIN * TEST_WIDTH, 0);
+        std::fill(band.begin() + TEST_BAND_END * TEST_WIDTH, band.end(), 0);
+        check("raster_spans band", t, band, spans(t, TEST_BAND_BEGIN, TEST_BAND_END));
+    }
+
+    printf("raster_test: %zu triangles, %d failed\n", tris.size(), failures);
+    return failures ? 1 : 0;
+}